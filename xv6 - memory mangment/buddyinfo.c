@@ -0,0 +1,39 @@
+// Show how fragmented free physical memory is: the free blocks of
+// each order in the kernel's buddy allocator and, per order, the
+// unusable free space index, the share of free pages that sit in
+// blocks too small for an allocation of that order.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+
+uint nblocks[KMAXORDER+1];
+
+int
+main(int argc, char *argv[])
+{
+  int o, i, cached;
+  uint free, small;
+
+  if((cached = buddyinfo(nblocks)) < 0){
+    printf(2, "buddyinfo: failed\n");
+    exit();
+  }
+  free = cached;
+  for(o = 0; o <= KMAXORDER; o++)
+    free += nblocks[o] << o;
+  printf(1, "%d free pages, %d of them in CPU caches\n", free, cached);
+  printf(1, "order  blocks  unusable\n");
+  small = 0;
+  for(o = 0; o <= KMAXORDER; o++){
+    // free pages in blocks below order o, in percent; a cached page
+    // serves an order 0 kalloc() but nothing bigger
+    i = free ? small * 100 / free : 0;
+    printf(1, "%d  %d  %d%%\n", o, nblocks[o], i);
+    small += nblocks[o] << o;
+    if(o == 0)
+      small += cached;
+  }
+  exit();
+}
@@ -9,6 +9,8 @@ struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct traceref;
+struct kmem_cache;
 
 // bio.c
 void            binit(void);
@@ -56,6 +58,8 @@ int				createSwapFile(struct proc* p);
 int				readFromSwapFile(struct proc * p, char* buffer, uint placeOnFile, uint size);
 int				writeToSwapFile(struct proc* p, char* buffer, uint placeOnFile, uint size);
 int				removeSwapFile(struct proc* p);
+int				readPagesFromSwapFile(struct proc*, char**, uint, int);
+int				writePagesToSwapFile(struct proc*, char**, uint, int);
 
 
 // sysfile
@@ -67,6 +71,8 @@ int				isdirempty(struct inode *dp);
 void            ideinit(void);
 void            ideintr(void);
 void            iderw(struct buf*);
+uint            ideswapsize(void);
+int             ideswaprw(char**, uint, int, int);
 
 // ioapic.c
 void            ioapicenable(int irq, int cpu);
@@ -81,6 +87,9 @@ void            kinit1(void*, void*);
 void            kinit2(void*, void*);
 uint            getTotalNumOfFreePages();
 uint            getCurrentNumOfFreePages();
+char*           kallocpages(int);
+void            kfreepages(char*, int);
+int             buddyinfo(uint*);
 
 // kbd.c
 void            kbdintr(void);
@@ -109,12 +118,30 @@ void            picenable(int);
 void            picinit(void);
 
 // pipe.c
+void            pipeinit(void);
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, char*, int);
 int             pipewrite(struct pipe*, char*, int);
 
 //PAGEBREAK: 16
+// policy.c
+int             policyok(int);
+char*           policyname(int);
+int             policyof(struct proc*);
+void            policytick(struct proc*);
+void            harvest(struct proc*, int);
+char*           choosePage(struct proc*);
+int             pageclean(struct proc*, int);
+int             findInRam(struct proc*, char*);
+int             addPage(struct proc*, char*, pte_t*);
+void            removePage(struct proc*, int);
+int             ghostHit(struct proc*, char*);
+void            NFU_update(struct proc*);
+void            aq_update(struct proc*);
+void            ws_update(struct proc*);
+void            mglru_update(struct proc*);
+
 // proc.c
 int             cpuid(void);
 void            exit(void);
@@ -136,11 +163,41 @@ void            inc(struct proc * p,char* v);
 void            dec(struct proc * p,char* v);
 int             getRef(struct proc * p,char* v);
 struct page*    findPage(struct proc * p, char* v);
-void            NFU_update();
+int             setpaging(int, int);
+int             setpff(int, int);
+int             setpolicy(int, int);
+int             residentpages(void);
+struct proc*    clockproc(struct proc*);
+void            clockdone(struct proc*, int);
+void            kswapdinit(void);
+void            kswapdwake(void);
+void            agetick(void);
+
+// swap.c
+extern int      swapdev;
+void            swapinit(void);
+int             swapopen(struct proc*);
+int             swapclose(struct proc*);
+void            swapdrop(struct proc*);
+int             swaplimit(void);
+int             swapalloc(struct proc*, int);
+void            swapfree(struct proc*, int);
+int             swapread(struct proc*, char**, int, int);
+int             swapwrite(struct proc*, char**, int, int);
+int             swapdup(struct proc*, struct proc*);
+int             swapstore(char*);
+uint            getZeroPageOuts();
 
 // swtch.S
 void            swtch(struct context**, struct context*);
 
+// slab.c
+void            slabinit(void);
+struct kmem_cache* kmem_cache_create(char*, uint);
+void*           kmem_cache_alloc(struct kmem_cache*);
+void            kmem_cache_free(struct kmem_cache*, void*);
+void            slabdump(void);
+
 // spinlock.c
 void            acquire(struct spinlock*);
 void            getcallerpcs(void*, uint*);
@@ -182,6 +239,12 @@ extern uint     ticks;
 void            tvinit(void);
 extern struct spinlock tickslock;
 
+// trace.c
+void            traceinit(void);
+void            traceref(struct proc*, char*, int);
+int             tracectl(int);
+int             traceread(struct traceref*, int);
+
 // uart.c
 void            uartinit(void);
 void            uartintr(void);
@@ -194,6 +257,7 @@ pde_t*          setupkvm(void);
 char*           uva2ka(pde_t*, char*);
 int             allocuvm(pde_t*, uint, uint);
 int             deallocuvm(pde_t*, uint, uint);
+void            trackImage(struct proc*);
 void            freevm(pde_t*);
 void            inituvm(pde_t*, char*, uint);
 int             loaduvm(pde_t*, char*, struct inode*, uint, uint);
@@ -205,9 +269,22 @@ int             copyout(pde_t*, uint, void*, uint);
 void            clearpteu(pde_t *pgdir, char *uva);
 pte_t *         walkpgdir(pde_t *pgdir, const void *va, int alloc);  ///we add this for using in trap.c
 void            pageOut(struct proc* p);
+int             pageOutCluster(struct proc* p, int n);
 int             mappages(pde_t *pgdir, void *va, uint size, uint pa, int perm);
 void            pageFault();
+void            raAccount(pte_t*);
+uint            getRaHits();
+uint            getRaMisses();
+uint            getSwapWrites();
 
+// zram.c
+void            zraminit(void);
+int             zramstore(char*);
+int             zramload(int, char*);
+int             zramdup(int);
+void            zramfree(int);
+uint            getZramPages();
+uint            getZramFrames();
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
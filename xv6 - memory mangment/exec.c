@@ -18,23 +18,14 @@ exec(char *path, char **argv)
   struct proghdr ph;
   pde_t *pgdir, *oldpgdir;
   struct proc * curproc = myproc();
-  if(curproc->pid > 2){
-    for (int i = 0; i < curproc->physical_num_of_pages; i++){  // hen and the painter
-      curproc->ram_queue[i].va = 0;
-    }
-    curproc->physical_num_of_pages = 0;       
-    curproc->phy_index = 0;
-    curproc->current_num_of_pages = 0;
-    curproc->out_index =  0;
-    curproc->swapMetaCounter = 0;
-    // removeSwapFile(curproc);  // do we need this too?
-  }
+  curproc->vmbusy++;                     // kswapd keeps off until the new image is in place
 
   begin_op();
 
   if((ip = namei(path)) == 0){
     end_op();
     cprintf("exec: fail\n");
+    curproc->vmbusy--;
     return -1;
   }
   ilock(ip);
@@ -111,7 +102,23 @@ exec(char *path, char **argv)
   curproc->tf->eip = elf.entry;  // main
   curproc->tf->esp = sp;
   switchuvm(curproc);
+  if(curproc->pid > 2){                  // the ram_queue points into oldpgdir, start it over
+    swapdrop(curproc);
+    curproc->swap_num_of_pages = 0;      // the old image's slots are freed with its pgdir
+    for (int i = 0; i < curproc->phy_index; i++){  // hen and the painter
+      curproc->ram_queue[i].va = 0;
+    }
+    curproc->physical_num_of_pages = 0;
+    curproc->phy_index = 0;
+    curproc->current_num_of_pages = 0;
+    curproc->out_index =  0;
+    curproc->hot_index = 0;
+    memset(curproc->ghost, 0, sizeof(curproc->ghost));   // addresses of the old image
+  }
   freevm(oldpgdir);
+  if(curproc->pid > 2)
+    trackImage(curproc);
+  curproc->vmbusy--;
   return 0;
  bad:
   if(pgdir)
@@ -120,5 +127,6 @@ exec(char *path, char **argv)
     iunlockput(ip);
     end_op();
   }
+  curproc->vmbusy--;
   return -1;
 }
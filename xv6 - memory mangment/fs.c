@@ -811,3 +811,50 @@ readFromSwapFile(struct proc * p, char* buffer, uint placeOnFile, uint size)
 
   return fileread(p->swapFile, buffer,  size);
 }
+
+// Write the n pages pg[0..n-1] to the swap file at placeOnFile with
+// one call. The pages need not be next to each other in memory; the
+// log transactions are as many as filewrite() uses for n*PGSIZE bytes.
+// Returns 0 on success.
+int
+writePagesToSwapFile(struct proc *p, char **pg, uint placeOnFile, int n)
+{
+  struct inode *ip = p->swapFile->ip;
+  uint max = ((MAXOPBLOCKS-1-1-2) / 2) * 512;
+  uint done, total, op, n1;
+
+  total = n * PGSIZE;
+  for(done = 0; done < total; ){
+    begin_op();
+    ilock(ip);
+    for(op = 0; op < max && done < total; op += n1, done += n1){
+      n1 = max - op;
+      if(n1 > PGSIZE - done % PGSIZE)     // don't run past this page
+        n1 = PGSIZE - done % PGSIZE;
+      if(writei(ip, pg[done / PGSIZE] + done % PGSIZE, placeOnFile + done, n1) != n1){
+        iunlock(ip);
+        end_op();
+        return -1;
+      }
+    }
+    iunlock(ip);
+    end_op();
+  }
+  return 0;
+}
+
+// Read n pages at placeOnFile into pg[0..n-1] with one call.
+// Returns 0 on success.
+int
+readPagesFromSwapFile(struct proc *p, char **pg, uint placeOnFile, int n)
+{
+  struct inode *ip = p->swapFile->ip;
+  int i, r;
+
+  ilock(ip);
+  for(i = 0, r = 0; i < n && r == 0; i++)
+    if(readi(ip, pg[i], placeOnFile + i * PGSIZE, PGSIZE) != PGSIZE)
+      r = -1;
+  iunlock(ip);
+  return r;
+}
@@ -17,12 +17,14 @@
 #define IDE_BSY       0x80
 #define IDE_DRDY      0x40
 #define IDE_DF        0x20
+#define IDE_DRQ       0x08
 #define IDE_ERR       0x01
 
 #define IDE_CMD_READ  0x20
 #define IDE_CMD_WRITE 0x30
 #define IDE_CMD_RDMUL 0xc4
 #define IDE_CMD_WRMUL 0xc5
+#define IDE_CMD_IDENT 0xec
 
 // idequeue points to the buf now being read/written to the disk.
 // idequeue->qnext points to the next buf to be processed.
@@ -32,6 +34,7 @@ static struct spinlock idelock;
 static struct buf *idequeue;
 
 static int havedisk1;
+static uint disk1size;   // sectors on disk 1, from IDENTIFY
 static void idestart(struct buf*);
 
 // Wait for IDE disk to become ready.
@@ -47,6 +50,38 @@ idewait(int checkerr)
   return 0;
 }
 
+// Wait for the disk to accept or deliver the next sector
+// of a PIO transfer.
+static int
+idewaitdrq(void)
+{
+  int r;
+
+  while((r = inb(0x1f7)) & IDE_BSY)
+    ;
+  if((r & (IDE_DF|IDE_ERR)) != 0 || (r & IDE_DRQ) == 0)
+    return -1;
+  return 0;
+}
+
+// Ask the currently selected disk how many sectors it has.
+// Called from ideinit, before any request is queued.
+static uint
+ideidentify(void)
+{
+  uint id[SECTOR_SIZE/4];
+
+  outb(0x3f6, 2);  // no interrupt for this one
+  outb(0x1f7, IDE_CMD_IDENT);
+  if(inb(0x1f7) == 0 || idewaitdrq() < 0){
+    outb(0x3f6, 0);
+    return 0;
+  }
+  insl(0x1f0, id, SECTOR_SIZE/4);
+  outb(0x3f6, 0);
+  return id[30];  // words 60-61: number of LBA28 sectors
+}
+
 void
 ideinit(void)
 {
@@ -64,6 +99,8 @@ ideinit(void)
       break;
     }
   }
+  if(havedisk1)
+    disk1size = ideidentify();
 
   // Switch back to disk 0.
   outb(0x1f6, 0xe0 | (0<<4));
@@ -126,6 +163,8 @@ ideintr(void)
   // Start disk on next buf in queue.
   if(idequeue != 0)
     idestart(idequeue);
+  else
+    wakeup(&idequeue);  // ideswaprw may be waiting for an idle disk
 
   release(&idelock);
 }
@@ -166,3 +205,65 @@ iderw(struct buf *b)
 
   release(&idelock);
 }
+
+// Number of sectors on disk 1 past the file system, available
+// for the raw swap area. 0 if there is no such space.
+uint
+ideswapsize(void)
+{
+  uint fssectors = FSSIZE * (BSIZE/SECTOR_SIZE);
+
+  if(!havedisk1 || disk1size <= fssectors)
+    return 0;
+  return disk1size - fssectors;
+}
+
+// Read or write npages consecutive pages of the raw swap area,
+// to or from the pages pg[0..npages-1], which need not be next to
+// each other in memory. sector is relative to the start of the
+// swap area. The pages move with a single multi-sector command,
+// polled instead of interrupt driven, straight between the frames
+// and the disk, bypassing the buffer cache and the log.
+int
+ideswaprw(char **pg, uint sector, int npages, int write)
+{
+  int i, n;
+  char *s;
+
+  if(!havedisk1)
+    panic("ideswaprw: ide disk 1 not present");
+
+  n = npages * (PGSIZE/SECTOR_SIZE);
+  if(n <= 0 || n > 255)
+    panic("ideswaprw: bad size");
+  sector += FSSIZE * (BSIZE/SECTOR_SIZE);
+
+  acquire(&idelock);
+  // Let the queued buf requests finish; we own the disk until release.
+  while(idequeue != 0)
+    sleep(&idequeue, &idelock);
+
+  idewait(0);
+  outb(0x3f6, 2);  // we poll, no interrupt
+  outb(0x1f2, n);  // number of sectors
+  outb(0x1f3, sector & 0xff);
+  outb(0x1f4, (sector >> 8) & 0xff);
+  outb(0x1f5, (sector >> 16) & 0xff);
+  outb(0x1f6, 0xe0 | (1<<4) | ((sector>>24)&0x0f));
+  outb(0x1f7, write ? IDE_CMD_WRITE : IDE_CMD_READ);
+  for(i = 0; i < n; i++){
+    if(idewaitdrq() < 0)
+      break;
+    s = pg[i / (PGSIZE/SECTOR_SIZE)] + (i % (PGSIZE/SECTOR_SIZE)) * SECTOR_SIZE;
+    if(write)
+      outsl(0x1f0, s, SECTOR_SIZE/4);
+    else
+      insl(0x1f0, s, SECTOR_SIZE/4);
+  }
+  if(i == n && idewait(1) < 0)
+    i = -1;
+  outb(0x3f6, 0);
+
+  release(&idelock);
+  return i == n ? 0 : -1;
+}
@@ -1,6 +1,13 @@
 // Physical memory allocator, intended to allocate
 // memory for user processes, kernel stacks, page table pages,
-// and pipe buffers. Allocates 4096-byte pages.
+// and pipe buffers. Allocates 4096-byte pages, or with
+// kallocpages() runs of 2^order contiguous pages.
+//
+// Free memory is kept by a buddy allocator: one free list per order
+// 0..KMAXORDER, each holding blocks of 2^order pages aligned to their
+// size. An allocation splits the smallest block that fits, a free
+// merges the block with its buddy for as long as the buddy is free
+// too, so freed pages grow back into large blocks.
 
 #include "types.h"
 #include "defs.h"
@@ -9,23 +16,106 @@
 #include "mmu.h"
 #include "spinlock.h"
 
+#define NPHYSPAGES (PHYSTOP/PGSIZE)
+
 void freerange(void *vstart, void *vend);
 extern char end[]; // first address after kernel loaded from ELF file
                    // defined by the kernel linker script in kernel.ld
 
 struct run {
   struct run *next;
+  struct run *prev;            // only used on the buddy lists
 };
 
 struct {
   struct spinlock lock;
   int use_lock;
-  struct run *freelist;
+  struct run *free[KMAXORDER+1];  // free blocks of each order
+  uint nblocks[KMAXORDER+1];
+  uchar order[NPHYSPAGES];     // order+1 if the page starts a free block
+  int nfree;                   // pages in free blocks
 } kmem;
 
+// Each CPU keeps up to KCACHE free pages to itself, so kalloc() and
+// kfree() mostly take only that CPU's lock, which no other CPU wants.
+// A cache refills from the buddy lists, and drains back to them,
+// KCACHE/2 pages at a time; kmem.lock is only taken then. When the
+// buddy lists run dry, kalloc() takes a page from another CPU's cache.
+// Until kinit2() the caches are not used.
+struct kcache {
+  struct spinlock lock;
+  struct run *freelist;
+  int n;
+} kcache[NCPU];
+
 uint totalNumOfFreePages;
-uint currentNumOfFreePages;
 
+static void
+blockpush(struct run *r, int o)
+{
+  r->prev = 0;
+  r->next = kmem.free[o];
+  if(r->next)
+    r->next->prev = r;
+  kmem.free[o] = r;
+  kmem.nblocks[o]++;
+  kmem.order[V2P(r)/PGSIZE] = o + 1;
+}
+
+static void
+blockremove(struct run *r, int o)
+{
+  if(r->prev)
+    r->prev->next = r->next;
+  else
+    kmem.free[o] = r->next;
+  if(r->next)
+    r->next->prev = r->prev;
+  kmem.nblocks[o]--;
+  kmem.order[V2P(r)/PGSIZE] = 0;
+}
+
+// Take a block of 2^order pages off the buddy lists, splitting a
+// larger one if need be. Caller holds kmem.lock if use_lock.
+static struct run*
+buddyalloc(int order)
+{
+  struct run *r;
+  int o;
+
+  for(o = order; o <= KMAXORDER && kmem.free[o] == 0; o++)
+    ;
+  if(o > KMAXORDER)
+    return 0;
+  r = kmem.free[o];
+  blockremove(r, o);
+  while(o > order){                      // give back the upper halves
+    o--;
+    blockpush((struct run*)((char*)r + (PGSIZE << o)), o);
+  }
+  kmem.nfree -= 1 << order;
+  return r;
+}
+
+// Put a block of 2^order pages back, merging it with its buddy
+// while that is free and of the same order.
+static void
+buddyfree(struct run *r, int order)
+{
+  uint pa, buddy;
+  int o;
+
+  kmem.nfree += 1 << order;
+  pa = V2P(r);
+  for(o = order; o < KMAXORDER; o++){
+    buddy = pa ^ (PGSIZE << o);
+    if(buddy >= PHYSTOP || kmem.order[buddy/PGSIZE] != o + 1)
+      break;
+    blockremove((struct run*)P2V(buddy), o);
+    pa &= ~(PGSIZE << o);
+  }
+  blockpush((struct run*)P2V(pa), o);
+}
 
 // Initialization happens in two phases.
 // 1. main() calls kinit1() while still using entrypgdir to place just
@@ -35,9 +125,12 @@ uint currentNumOfFreePages;
 void
 kinit1(void *vstart, void *vend)
 {
+  int i;
+
   totalNumOfFreePages = (vend - vstart) / PGSIZE;
-  currentNumOfFreePages = 0;
   initlock(&kmem.lock, "kmem");
+  for(i = 0; i < NCPU; i++)
+    initlock(&kcache[i].lock, "kcache");
   kmem.use_lock = 0;
   freerange(vstart, vend);
 }
@@ -58,6 +151,20 @@ freerange(void *vstart, void *vend)
   for(; p + PGSIZE <= (char*)vend; p += PGSIZE)
     kfree(p); 
 }
+
+// This CPU's cache. The caller may move to another CPU after, which
+// is harmless: it still takes the lock of the cache it got.
+static struct kcache*
+mycache(void)
+{
+  struct kcache *c;
+
+  pushcli();
+  c = &kcache[cpuid()];
+  popcli();
+  return c;
+}
+
 //PAGEBREAK: 21
 // Free the page of physical memory pointed at by v,
 // which normally should have been returned by a
@@ -66,23 +173,60 @@ freerange(void *vstart, void *vend)
 void
 kfree(char *v)
 {
-  currentNumOfFreePages++;
+  struct kcache *c;
   struct run *r;
+  int n;
+
   if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP){
     cprintf("kfree about to panic. v % pgsize: %d, v: %x, end: %x v2p(v): %x, phystop: %x\n",(uint)v % PGSIZE, v, end, V2P(v),PHYSTOP);
     panic("kfree");
   }
-  if(kmem.use_lock)
-    acquire(&kmem.lock);
   r = (struct run*)v;
   // Fill with junk to catch dangling refs.
   memset(v, 1, PGSIZE);
-  r->next = kmem.freelist;
-  kmem.freelist = r;
-  if(kmem.use_lock)
+  if(!kmem.use_lock){
+    buddyfree(r, 0);
+    return;
+  }
+  c = mycache();
+  acquire(&c->lock);
+  r->next = c->freelist;
+  c->freelist = r;
+  if(++c->n > KCACHE){                   // full, give half back
+    acquire(&kmem.lock);
+    for(n = 0; n < KCACHE/2; n++){
+      r = c->freelist;
+      c->freelist = r->next;
+      buddyfree(r, 0);
+    }
     release(&kmem.lock);
+    c->n -= n;
+  }
+  release(&c->lock);
 }
 
+// Take a page from some other CPU's cache, when the buddy lists
+// have none.
+static struct run*
+steal(struct kcache *mine)
+{
+  struct kcache *c;
+  struct run *r;
+
+  for(c = kcache; c < &kcache[NCPU]; c++){
+    if(c == mine)
+      continue;
+    acquire(&c->lock);
+    if((r = c->freelist) != 0){
+      c->freelist = r->next;
+      c->n--;
+    }
+    release(&c->lock);
+    if(r)
+      return r;
+  }
+  return 0;
+}
 
 // Allocate one 4096-byte page of physical memory.
 // Returns a pointer that the kernel can use.
@@ -90,21 +234,122 @@ kfree(char *v)
 char*
 kalloc(void)
 {
-  currentNumOfFreePages--;
+  struct kcache *c;
   struct run *r;
-  if(kmem.use_lock)
+  int n;
+
+  if(!kmem.use_lock)
+    return (char*)buddyalloc(0);
+  c = mycache();
+  acquire(&c->lock);
+  if(c->n == 0){                         // empty, get half a cache full
     acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r){
-    kmem.freelist = r->next;
+    for(n = 0; n < KCACHE/2 && (r = buddyalloc(0)) != 0; n++){
+      r->next = c->freelist;
+      c->freelist = r;
+    }
+    release(&kmem.lock);
+    c->n += n;
+  }
+  if((r = c->freelist) != 0){
+    c->freelist = r->next;
+    c->n--;
   }
-  if(kmem.use_lock)
+  release(&c->lock);
+  if(r == 0)
+    r = steal(c);
+  if(getCurrentNumOfFreePages() < KSWAPD_LOW)
+    kswapdwake();
+  return (char*)r;
+}
+
+// Give every CPU cache back to the buddy lists, so the pages in
+// them can merge into larger blocks again.
+static void
+cachedrain(void)
+{
+  struct kcache *c;
+  struct run *r;
+
+  for(c = kcache; c < &kcache[NCPU]; c++){
+    acquire(&c->lock);
+    acquire(&kmem.lock);
+    while((r = c->freelist) != 0){
+      c->freelist = r->next;
+      buddyfree(r, 0);
+    }
     release(&kmem.lock);
+    c->n = 0;
+    release(&c->lock);
+  }
+}
+
+// Allocate 2^order physically contiguous pages, aligned to their
+// size. Returns 0 if there is no such block, even after pulling
+// back the pages the CPU caches hold. Free with kfreepages().
+char*
+kallocpages(int order)
+{
+  struct run *r;
+
+  if(order < 0 || order > KMAXORDER)
+    return 0;
+  if(order == 0)
+    return kalloc();
+  acquire(&kmem.lock);
+  r = buddyalloc(order);
+  release(&kmem.lock);
+  if(r == 0){
+    cachedrain();
+    acquire(&kmem.lock);
+    r = buddyalloc(order);
+    release(&kmem.lock);
+  }
+  if(getCurrentNumOfFreePages() < KSWAPD_LOW)
+    kswapdwake();
   return (char*)r;
 }
 
+void
+kfreepages(char *v, int order)
+{
+  if(order == 0){
+    kfree(v);
+    return;
+  }
+  if(order < 0 || order > KMAXORDER || V2P(v) % (PGSIZE << order) || v < end || V2P(v) + (PGSIZE << order) > PHYSTOP)
+    panic("kfreepages");
+  memset(v, 1, PGSIZE << order);
+  acquire(&kmem.lock);
+  buddyfree((struct run*)v, order);
+  release(&kmem.lock);
+}
+
+// Fill nblocks[0..KMAXORDER] with the number of free blocks of each
+// order. Returns the pages held in CPU caches, which count as order 0
+// blocks that cannot merge until they are given back.
+int
+buddyinfo(uint *nblocks)
+{
+  int o, n;
+
+  n = 0;
+  for(o = 0; o < NCPU; o++)
+    n += kcache[o].n;
+  acquire(&kmem.lock);
+  for(o = 0; o <= KMAXORDER; o++)
+    nblocks[o] = kmem.nblocks[o];
+  release(&kmem.lock);
+  return n;
+}
+
+// Free pages, in kmem and in the CPU caches. Not exact while
+// other CPUs allocate, which is fine for deciding when to reclaim.
 uint getCurrentNumOfFreePages(){
-  return currentNumOfFreePages;
+  int i, n = kmem.nfree;
+  for(i = 0; i < NCPU; i++)
+    n += kcache[i].n;
+  return n;
 }
 
 uint getTotalNumOfFreePages(){
@@ -30,10 +30,15 @@ main(void)
   tvinit();        // trap vectors
   binit();         // buffer cache
   fileinit();      // file table
+  slabinit();      // small object caches
+  pipeinit();      // pipe cache
   ideinit();       // disk 
+  swapinit();      // swap space
+  traceinit();     // page reference tracing
   startothers();   // start other processors
   kinit2(P2V(4*1024*1024), P2V(PHYSTOP)); // must come after startothers()
   userinit();      // first user process
+  kswapdinit();    // background page-out thread
   mpmain();        // finish this processor's setup
 }
 
@@ -58,3 +58,16 @@ iderw(struct buf *b)
     memmove(b->data, p, BSIZE);
   b->flags |= B_VALID;
 }
+
+// No raw swap area; swap goes through the swap files.
+uint
+ideswapsize(void)
+{
+  return 0;
+}
+
+int
+ideswaprw(char **pg, uint sector, int npages, int write)
+{
+  panic("ideswaprw: no swap area");
+}
@@ -94,15 +94,24 @@ struct segdesc {
 #define PTE_P           0x001   // Present
 #define PTE_W           0x002   // Writeable
 #define PTE_U           0x004   // User
-#define PTE_A           0x008   // refrenced
+#define PTE_A           0x020   // Accessed (refrenced)
+#define PTE_D           0x040   // Dirty
 #define PTE_PS          0x080   // Page Size
 #define PTE_PG          0x200   // Paged out to secondary storage
+#define PTE_RA          0x400   // Read ahead from swap, not yet accounted
 #define PTE_COW         0x800   // flag that indicate if cowuvm occours
 
 // Address in page table or page directory entry
 #define PTE_ADDR(pte)   ((uint)(pte) & ~0xFFF)
 #define PTE_FLAGS(pte)  ((uint)(pte) &  0xFFF)
 
+// A paged out PTE (PTE_PG set, PTE_P clear) keeps its swap slot
+// where the physical address would be.
+#define PTE_SLOT(pte)   (PTE_ADDR(pte) >> PTXSHIFT)
+#define SLOT2PTE(slot)  ((uint)(slot) << PTXSHIFT)
+#define ZEROSLOT        0x7FFFF  // page was all zeros, nothing is stored
+#define ZRAMSLOT        0x80000  // slots from here on are in the compressed pool
+
 #ifndef __ASSEMBLER__
 typedef uint pte_t;
 
@@ -0,0 +1,478 @@
+// Page replacement simulator. Runs on the host, like mkfs.
+//
+// Builds the kernel's policy code (policy.c) against a mock of the
+// proc and PTE layer and replays a page reference trace through it
+// for each policy and number of frames asked for, one process whose
+// max_psyc_pages is the number of frames. A reference sets PTE_A
+// (and PTE_D for a write) in a mock page table; a reference to a
+// page that is not present is a fault, which pages out a victim
+// picked by choosePage() once the frames are full. Every -a
+// references are a timer tick: the process's vtime advances, and
+// every AGETICKS ticks policytick() ages its pages, as agetick()
+// does in the kernel. kswapd, PFF, swap read-ahead and clustered
+// page-outs are not simulated. Next to the kernel's policies it
+// runs two it cannot have, as yardsticks: opt, Belady's optimal
+// replacement, which evicts the page used again furthest in the
+// future, and lru, exact least recently used. -c adds the CLEANFIRST
+// variant of each kernel policy, shown as policy+clean.
+// Pages are aged every AGETICKS * -a references. That has to be short
+// next to how long a page stays resident, or the aging policies
+// (nfua, lapa, aq, wsclock, mglru) see no reference bits before they
+// evict and all pick like fifo. The default of 2 ages a page a few
+// times per residency even at 16 frames on the default trace.
+//
+// usage: pagesim [-t trace] [-n refs] [-u pages] [-w write%] [-s zipf-s]
+//                [-a refs-per-tick] [-S seed] [-p policy]... [-f frames]...
+//                [-c] [-k] [-P pid] [tracefile]
+// trace is seq (a scan that never reuses a page), loop (over -u
+// pages), zipf (Zipf over -u pages), phase (random in a working set
+// of -u/8 pages that moves every -n/8 references). A tracefile has
+// one page number per line, hex with 0x, and a trailing w for a
+// write. With -k it is a kernel trace written by tracedump: the
+// faults and PTE_A harvests of process -P, by default the one with
+// the most records. A harvest only says a page was used since the
+// last one, so such a trace is coarser than the program's real
+// references.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+
+#define PAGESIM
+#define MAX_RAM_QUEUE 4096     // the ram_queue here is not limited to a page
+#include "types.h"
+#include "param.h"
+#include "mmu.h"
+#include "proc.h"
+
+// What policy.c needs from the rest of the kernel.
+#define NELEM(x) (sizeof(x)/sizeof((x)[0]))
+
+static void
+panic(char *s)
+{
+  fprintf(stderr, "pagesim: panic: %s\n", s);
+  exit(1);
+}
+
+static void
+traceref(struct proc *p, char *va, int kind)
+{
+}
+
+static void
+raAccount(pte_t *pte)
+{
+  *pte &= ~PTE_RA;
+}
+
+static int
+swaplimit(void)
+{
+  return 1 << 30;
+}
+
+#include "policy.c"
+
+#define MAXFRAMES  64
+#define OPT        -1          // Belady: the page used again furthest in the future
+#define LRU        -2          // exact least recently used
+
+struct result {
+  uint faults;
+  uint pageouts;
+  uint writes;                 // page-outs that had to be written to swap
+};
+
+uint *trace;                   // page number << 1 | 1 for a write
+int nrefs;
+int npages;                    // page numbers are below this
+pte_t *pt;                     // mock page table, by page number
+struct page ram_queue[MAX_RAM_QUEUE];
+int *nextuse;                  // where the page of each reference is used next
+int agerefs = 2;                // references per timer tick
+
+static unsigned long long rng = 88172645463325252ULL;
+
+static unsigned long long
+xorshift(void)
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+static double
+uniform(void)
+{
+  return (xorshift() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Page pn sits at pn+1 pages, as choosePage() returns 0 for no page.
+static char*
+pn2va(uint pn)
+{
+  return (char*)((unsigned long)(pn + 1) * PGSIZE);
+}
+
+static void
+pageout(struct proc *p, struct result *r)
+{
+  char *va;
+  pte_t *pte;
+  int k;
+
+  if((va = choosePage(p)) == 0)
+    panic("no victim");
+  if((k = findInRam(p, va)) < 0)
+    panic("victim not resident");
+  pte = p->ram_queue[k].pte;
+  if(p->ram_queue[k].slot < 0 || (*pte & PTE_D))
+    r->writes++;                              // no clean copy in swap
+  removePage(p, k);
+  *pte = PTE_PG;
+  p->physical_num_of_pages--;
+  r->pageouts++;
+}
+
+static void
+simulate(int pol, int frames, struct result *r)
+{
+  struct proc p;
+  pte_t *pte;
+  uint pn;
+  int i, k, ticks, t, swapped;
+
+  memset(&p, 0, sizeof(p));
+  memset(r, 0, sizeof(*r));
+  memset(pt, 0, npages * sizeof(pte_t));
+  p.pid = 3;
+  p.policy = p.newpolicy = pol & ~CLEANFIRST;
+  p.cleanfirst = (pol & CLEANFIRST) != 0;
+  p.ram_queue = ram_queue;
+  p.max_psyc_pages = frames;
+  p.cold_target = frames / 4;
+  ticks = t = 0;
+  for(i = 0; i < nrefs; i++){
+    pn = trace[i] >> 1;
+    pte = &pt[pn];
+    if(!(*pte & PTE_P)){
+      r->faults++;
+      if(p.physical_num_of_pages >= p.max_psyc_pages)
+        pageout(&p, r);
+      swapped = *pte & PTE_PG;
+      *pte = PTE_P | PTE_W | PTE_U;
+      k = addPage(&p, pn2va(pn), pte);
+      if(swapped){
+        p.ram_queue[k].slot = 0;              // its swap copy stays, as in swapIn()
+        if(p.policy == CLOCKPRO && ghostHit(&p, pn2va(pn)))
+          p.ram_queue[k].hot = 1;
+      }
+      p.physical_num_of_pages++;
+    }
+    *pte |= PTE_A;
+    if(trace[i] & 1)
+      *pte |= PTE_D;
+    if(++t == agerefs){
+      t = 0;
+      p.vtime++;
+      if(++ticks % AGETICKS == 0)
+        policytick(&p);
+    }
+  }
+}
+
+static char*
+polname(int pol)
+{
+  static char buf[32];
+
+  if(pol == OPT)
+    return "opt";
+  if(pol == LRU)
+    return "lru";
+  if(pol & CLEANFIRST){
+    snprintf(buf, sizeof(buf), "%s+clean", policyname(pol & ~CLEANFIRST));
+    return buf;
+  }
+  return policyname(pol);
+}
+
+static void
+mknextuse(void)
+{
+  int *last, i;
+  uint pn;
+
+  if((nextuse = malloc(nrefs * sizeof(int))) == 0 || (last = malloc(npages * sizeof(int))) == 0)
+    panic("out of memory");
+  for(pn = 0; pn < npages; pn++)
+    last[pn] = nrefs;
+  for(i = nrefs - 1; i >= 0; i--){
+    pn = trace[i] >> 1;
+    nextuse[i] = last[pn];
+    last[pn] = i;
+  }
+  free(last);
+}
+
+// OPT and LRU know more than reference bits tell: each frame has
+// the time its page is used next (OPT) or was used last (LRU). In
+// pt, PTE_PG here means the page has a copy in swap.
+static void
+ideal(int pol, int frames, struct result *r)
+{
+  static int frame[MAX_RAM_QUEUE], when[MAX_RAM_QUEUE];
+  static int *where;
+  int i, k, v, n;
+  uint pn, q;
+
+  if(where == 0 && (where = malloc(npages * sizeof(int))) == 0)
+    panic("out of memory");
+  memset(r, 0, sizeof(*r));
+  memset(pt, 0, npages * sizeof(pte_t));
+  for(i = n = 0; i < nrefs; i++){
+    pn = trace[i] >> 1;
+    if(!(pt[pn] & PTE_P)){
+      r->faults++;
+      if(n == frames){
+        for(v = 0, k = 1; k < frames; k++)
+          if(pol == OPT ? when[k] > when[v] : when[k] < when[v])
+            v = k;
+        q = frame[v];
+        if(!(pt[q] & PTE_PG) || (pt[q] & PTE_D))
+          r->writes++;
+        pt[q] = PTE_PG;
+        r->pageouts++;
+      } else
+        v = n++;
+      frame[v] = pn;
+      where[pn] = v;
+      pt[pn] = (pt[pn] & PTE_PG) | PTE_P;
+    }
+    if(trace[i] & 1)
+      pt[pn] |= PTE_D;
+    when[where[pn]] = pol == OPT ? nextuse[i] : i;
+  }
+}
+
+static void
+addref(uint pn, int w)
+{
+  static int cap;
+
+  if(nrefs == cap){
+    cap = cap ? 2*cap : 1 << 16;
+    if((trace = realloc(trace, cap * sizeof(uint))) == 0)
+      panic("out of memory");
+  }
+  trace[nrefs++] = pn << 1 | (w != 0);
+  if(pn >= npages)
+    npages = pn + 1;
+}
+
+static void
+readtrace(char *file)
+{
+  FILE *f;
+  char line[128], *e;
+  uint pn;
+
+  if((f = fopen(file, "r")) == 0){
+    perror(file);
+    exit(1);
+  }
+  while(fgets(line, sizeof(line), f)){
+    pn = strtoul(line, &e, 0);
+    if(e == line)
+      continue;
+    while(*e == ' ' || *e == '\t')
+      e++;
+    addref(pn, *e == 'w');
+  }
+  fclose(f);
+}
+
+// Read the records of process pid from a tracedump file,
+// or of the process with the most records if pid is 0.
+static int
+readktrace(char *file, int pid)
+{
+  static int count[1 << 16];
+  struct traceref *t;
+  FILE *f;
+  long n, i;
+
+  if((f = fopen(file, "r")) == 0){
+    perror(file);
+    exit(1);
+  }
+  fseek(f, 0, SEEK_END);
+  n = ftell(f) / sizeof(*t);
+  rewind(f);
+  if((t = malloc(n * sizeof(*t) + 1)) == 0 || fread(t, sizeof(*t), n, f) != n)
+    panic("cannot read trace");
+  fclose(f);
+  if(pid == 0){
+    for(i = 0; i < n; i++)
+      if(++count[t[i].pid] > count[pid])
+        pid = t[i].pid;
+  }
+  for(i = 0; i < n; i++)
+    if(t[i].pid == pid)
+      addref(t[i].va / PGSIZE, 0);
+  free(t);
+  return pid;
+}
+
+static void
+maketrace(char *kind, int n, int u, int wpct, double s)
+{
+  double *cdf, sum;
+  int i, lo, hi, mid, w;
+  uint pn;
+
+  if(strcmp(kind, "seq") == 0){
+    for(i = 0; i < n; i++)
+      addref(i, xorshift() % 100 < wpct);
+  } else if(strcmp(kind, "loop") == 0){
+    for(i = 0; i < n; i++)
+      addref(i % u, xorshift() % 100 < wpct);
+  } else if(strcmp(kind, "zipf") == 0){
+    if((cdf = malloc(u * sizeof(double))) == 0)
+      panic("out of memory");
+    for(sum = 0, i = 0; i < u; i++)
+      cdf[i] = sum += 1.0 / pow(i + 1, s);
+    for(i = 0; i < n; i++){
+      sum = uniform() * cdf[u-1];
+      for(lo = 0, hi = u - 1; lo < hi; ){
+        mid = (lo + hi) / 2;
+        if(cdf[mid] < sum)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      addref(lo, xorshift() % 100 < wpct);
+    }
+    free(cdf);
+  } else if(strcmp(kind, "phase") == 0){
+    w = u / 8 > 0 ? u / 8 : 1;
+    for(i = 0; i < n; i++){
+      pn = ((i / (n / 8 + 1)) * w + xorshift() % w) % u;
+      addref(pn, xorshift() % 100 < wpct);
+    }
+  } else {
+    fprintf(stderr, "pagesim: unknown trace %s\n", kind);
+    exit(1);
+  }
+}
+
+static void
+usage(void)
+{
+  fprintf(stderr, "usage: pagesim [-t seq|loop|zipf|phase] [-n refs] [-u pages] [-w write%%]\n"
+                  "               [-s zipf-s] [-a refs-per-tick, default 2] [-S seed]\n"
+                  "               [-p policy]... [-f frames]... [-c] [-k] [-P pid] [tracefile]\n");
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pol[2*(NELEM(policies) + 2)], frames[MAXFRAMES];
+  int npol, nframes, n, u, wpct, c, i, j, ktrace, pid, clean;
+  char *kind;
+  double s, secs;
+  clock_t start;
+  struct result r;
+
+  kind = "zipf";
+  n = 1000000;
+  u = 1024;
+  wpct = 0;
+  s = 1.0;
+  npol = nframes = ktrace = pid = clean = 0;
+  while((c = getopt(argc, argv, "t:n:u:w:s:a:S:p:f:ckP:")) != -1){
+    switch(c){
+    case 't': kind = optarg; break;
+    case 'n': n = atoi(optarg); break;
+    case 'u': u = atoi(optarg); break;
+    case 'w': wpct = atoi(optarg); break;
+    case 's': s = atof(optarg); break;
+    case 'a': agerefs = atoi(optarg); break;
+    case 'S': rng = strtoull(optarg, 0, 0) | 1; break;
+    case 'c': clean = 1; break;
+    case 'k': ktrace = 1; break;
+    case 'P': pid = atoi(optarg); break;
+    case 'p':
+      for(i = LRU; i < (int)NELEM(policies) && !((i < 0 || policyok(i)) && strcmp(polname(i), optarg) == 0); i++)
+        ;
+      if(i == NELEM(policies) || npol == NELEM(policies) + 2){
+        fprintf(stderr, "pagesim: bad policy %s\n", optarg);
+        exit(1);
+      }
+      pol[npol++] = i;
+      break;
+    case 'f':
+      if(nframes == MAXFRAMES || (i = atoi(optarg)) < MIN_PSYC_PAGES || i > MAX_RAM_QUEUE){
+        fprintf(stderr, "pagesim: frames must be %d to %d\n", MIN_PSYC_PAGES, MAX_RAM_QUEUE);
+        exit(1);
+      }
+      frames[nframes++] = i;
+      break;
+    default:
+      usage();
+    }
+  }
+  if(n <= 0 || u <= 0 || agerefs <= 0 || optind < argc - 1)
+    usage();
+  if(optind < argc){
+    kind = argv[optind];
+    if(ktrace)
+      printf("process %d\n", readktrace(kind, pid));
+    else
+      readtrace(kind);
+  } else if(ktrace)
+    usage();
+  else
+    maketrace(kind, n, u, wpct, s);
+  if(nrefs == 0)
+    usage();
+  if(npol == 0){
+    pol[npol++] = OPT;
+    pol[npol++] = LRU;
+    for(i = 0; i < NELEM(policies); i++)
+      if(policyok(i) && i != GLOBAL)          // one process: GLOBAL is SCFIFO
+        pol[npol++] = i;
+  }
+  if(clean)
+    for(i = 0, j = npol; i < j; i++)
+      if(pol[i] >= 0)
+        pol[npol++] = pol[i] | CLEANFIRST;
+  if(nframes == 0)
+    for(i = 8; i <= 128; i *= 2)
+      frames[nframes++] = i;
+  if((pt = malloc(npages * sizeof(pte_t))) == 0)
+    panic("out of memory");
+  mknextuse();
+
+  printf("trace %s: %d references to %d pages, aged every %d\n", kind, nrefs, npages, agerefs * AGETICKS);
+  printf("%-15s %6s %10s %10s %10s %7s %8s\n", "policy", "frames", "faults", "pageouts", "writes", "hit%", "Mref/s");
+  for(i = 0; i < npol; i++)
+    for(j = 0; j < nframes; j++){
+      start = clock();
+      if(pol[i] < 0)
+        ideal(pol[i], frames[j], &r);
+      else
+        simulate(pol[i], frames[j], &r);
+      secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+      printf("%-15s %6d %10u %10u %10u %7.2f %8.1f\n", polname(pol[i]), frames[j],
+             r.faults, r.pageouts, r.writes, 100.0 * (nrefs - r.faults) / nrefs,
+             secs > 0 ? nrefs / secs / 1e6 : 0.0);
+    }
+  return 0;
+}
@@ -11,4 +11,25 @@
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
 #define FSSIZE       1000  // size of file system in blocks
+#define SWAPSIZE    16384  // size of raw swap area after the file system, in blocks
+#define SWAPCLUSTER     8  // max pages pageOut writes to swap in one request
+#define ZRAMPAGES     128  // most frames the compressed swap pool may take
+#define GLOBAL_PSYC_PAGES 512  // resident pages of all processes using GLOBAL
+#define AGETICKS        4  // timer ticks between two aging passes over a process
+#define WSCLOCK_TAU     32  // ticks of run time unused before a page leaves the working set
+#define MGLRU_GENS      4  // most generations MGLRU keeps per process
+#define NGHOST         32  // evicted cold pages CLOCKPRO remembers per process
+#define PFF_WINDOW      4  // quanta a process runs between PFF decisions
+#define PFF_LOW         1  // default: fewer faults per window, shrink the limit
+#define PFF_HIGH        8  // default: more faults per window, grow the limit
+#define PFF_STEP        4  // resident pages PFF adds or takes at a time
+#define TRACESIZE    4096  // page reference records the trace ring holds
+#define KMAXORDER      10  // largest kallocpages() block is 2^KMAXORDER pages
+#define NSLABCACHE      8  // most slab caches, see slab.c
+#define SLABMAG         8  // free objects each CPU keeps per slab cache
+#define KCACHE         32  // free pages each CPU keeps for itself in kalloc.c
+#define SWAPRA          4  // max pages a swap-in fault reads, <= SWAPCLUSTER
+#define KSWAPD_LOW    256  // wake kswapd when fewer frames are free
+#define KSWAPD_HIGH   512  // kswapd reclaims until this many frames are free
+#define KSWAPD_MARGIN   2  // resident slots kswapd keeps free below MAX_PSYC_PAGES
 
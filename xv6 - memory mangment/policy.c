@@ -0,0 +1,503 @@
+// Page replacement policies: the victim choosers, the aging passes
+// that harvest reference bits for them, and the ram_queue each
+// process keeps of its resident pages. Nothing here touches the
+// page tables except through the PTE pointers cached in the
+// ram_queue, so pagesim.c builds this file on the host, against a
+// mock of the proc and PTE layer, to replay reference traces.
+
+#ifndef PAGESIM
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "proc.h"
+#endif
+#include "policy.h"
+#include "trace.h"
+
+// Clear the reference bit of p's page i, which was found set.
+void
+harvest(struct proc *p, int i)
+{
+  raAccount(p->ram_queue[i].pte);
+  *p->ram_queue[i].pte &= ~PTE_A;
+  traceref(p, p->ram_queue[i].va, TR_REF);
+}
+
+// Evicting page i of p costs no swap write: swap still has its copy
+// and PTE_D says the page has not changed since it was read back.
+int
+pageclean(struct proc *p, int i)
+{
+  return p->ram_queue[i].slot >= 0 && !(*p->ram_queue[i].pte & PTE_D);
+}
+
+// The CLEANFIRST variant of a policy: among the pages the policy
+// ranks alike, a clean one goes before one that needs a swap write.
+// Sweeping choosers call passDirty() on each page they would take.
+// It passes over a dirty one, remembering the first in *dirty, which
+// is taken if a whole sweep finds no clean page. nfua and lapa break
+// counter ties with cleaner(). fifo and aq keep a strict order, and
+// wsclock already prefers clean pages, so CLEANFIRST does not change
+// them.
+static int
+passDirty(struct proc *p, int i, int *dirty)
+{
+  if(!p->cleanfirst || pageclean(p, i))
+    return 0;
+  if(*dirty < 0)
+    *dirty = i;
+  return 1;
+}
+
+// Should page i go before page j that ranks the same?
+static int
+cleaner(struct proc *p, int i, int j)
+{
+  return p->cleanfirst && pageclean(p, i) && !pageclean(p, j);
+}
+
+char* SC_FIFO(struct proc* p){
+  pte_t* pte;
+  int oldOut, n, dirty = -1;
+  for(n = 0; p->out_index < p->phy_index; n++, p->out_index = (p->out_index + 1) % p->phy_index){
+    if(n >= p->phy_index && dirty >= 0)
+      p->out_index = dirty;                       // no clean page in a whole sweep
+    else {
+      pte = p->ram_queue[p->out_index].pte;
+      if(*pte & PTE_A){ 
+        harvest(p, p->out_index);
+        continue;
+      }
+      if(passDirty(p, p->out_index, &dirty))
+        continue;
+    }
+    oldOut = p->out_index;
+    p->out_index = (p->out_index + 1) % p->phy_index;
+    return p->ram_queue[oldOut].va;
+  }
+  return 0; // we shouldnt get here
+}  
+
+char * fifo(struct proc * p){ //default is second chance fifo, for now we do fifo
+  int oldOut = p->out_index;
+  p->out_index = (p->out_index + 1) % p->phy_index;
+  return (char*)p->ram_queue[oldOut].va;
+}
+
+
+// Not frequently used with aging: the lowest aging counter.
+char * nfua(struct proc * p){
+  int i, best = 0;
+  for(i = 1; i < p->phy_index; i++)
+    if(p->ram_queue[i].nfua_counter < p->ram_queue[best].nfua_counter ||
+       (p->ram_queue[i].nfua_counter == p->ram_queue[best].nfua_counter && cleaner(p, i, best)))
+      best = i;
+  return p->ram_queue[best].va;
+}
+
+int find_numOnes(uint curr){
+  int count = 0;
+  for(int i = 0; i < 32; i++){
+    if(curr & 1){
+      count ++;
+    }
+    curr = curr >> 1;
+  }
+  return count;
+}
+
+// Least accessed page: the fewest 1 bits in its aging counter,
+// the lowest counter among those.
+char* lapa(struct proc* p){
+  int i, ones, best = 0;
+  int best_ones = find_numOnes(p->ram_queue[0].nfua_counter);
+  for(i = 1; i < p->phy_index; i++){
+    ones = find_numOnes(p->ram_queue[i].nfua_counter);
+    if(ones < best_ones || (ones == best_ones && (p->ram_queue[i].nfua_counter < p->ram_queue[best].nfua_counter ||
+       (p->ram_queue[i].nfua_counter == p->ram_queue[best].nfua_counter && cleaner(p, i, best))))){
+      best = i;
+      best_ones = ones;
+    }
+  }
+  return p->ram_queue[best].va;
+}
+
+char* aq(struct proc * p){
+
+  return p->ram_queue[p->phy_index - 1].va;
+}
+
+
+// WSClock: sweep from out_index. A page not used for more than
+// WSCLOCK_TAU ticks of p's run time is out of the working set, and a clean
+// one of those (its swap copy is still good) is taken at once.
+// Failing that the first old dirty page, else the page unused the
+// longest.
+char* wsclock(struct proc* p){
+  pte_t* pte;
+  int i, n, olddirty = -1, oldest = -1;
+  for(n = 0; n < p->phy_index; n++, p->out_index = (p->out_index + 1) % p->phy_index){
+    i = p->out_index;
+    pte = p->ram_queue[i].pte;
+    if(*pte & PTE_A){                             // used since the last look, in the working set
+      harvest(p, i);
+      p->ram_queue[i].last_use = p->vtime;
+      continue;
+    }
+    if(p->vtime - p->ram_queue[i].last_use > WSCLOCK_TAU){
+      if(pageclean(p, i)){
+        p->out_index = (i + 1) % p->phy_index;
+        return p->ram_queue[i].va;
+      }
+      if(olddirty < 0)
+        olddirty = i;
+    }
+    if(oldest < 0 || p->ram_queue[i].last_use < p->ram_queue[oldest].last_use)
+      oldest = i;
+  }
+  if(olddirty >= 0)
+    return p->ram_queue[olddirty].va;
+  if(oldest >= 0)
+    return p->ram_queue[oldest].va;
+  return p->ram_queue[p->out_index].va;          // all were in use, the hand is back at the start
+}
+
+// CLOCK-Pro, simplified. Resident pages are hot (reused) or cold.
+// Only cold pages are evicted, so a one-pass scan, whose pages are
+// all cold, cannot push out the hot set. The cold hand (out_index)
+// gives a referenced cold page a test period; referenced again in
+// it, the page turns hot. A cold page evicted in its test period is
+// remembered in p->ghost: faulting it back in soon makes it hot and
+// gives cold pages a slot more, one that leaves the ring unused
+// takes a slot away. The hot hand demotes unreferenced hot pages
+// whenever hot pages take more than their share.
+
+static void
+hotHand(struct proc* p, int hot)
+{
+  pte_t* pte;
+  int i, n, cold;
+  cold = p->cold_target < p->phy_index ? p->cold_target : p->phy_index - 1;
+  if(cold < 1)
+    cold = 1;
+  for(n = 0; hot > p->phy_index - cold && n < 2*p->phy_index; n++, p->hot_index++){
+    i = p->hot_index %= p->phy_index;
+    if(!p->ram_queue[i].hot)
+      continue;
+    pte = p->ram_queue[i].pte;
+    if(*pte & PTE_A){
+      harvest(p, i);
+      continue;
+    }
+    p->ram_queue[i].hot = 0;
+    p->ram_queue[i].test = 0;
+    hot--;
+  }
+}
+
+// A ghost is kept as va + PGSIZE, so page 0 can be one and 0 still
+// means an empty entry.
+static void
+ghostAdd(struct proc* p, char* va)
+{
+  if(p->ghost[p->ghost_next] && p->cold_target > 1)
+    p->cold_target--;                            // its test period ran out unused
+  p->ghost[p->ghost_next] = va + PGSIZE;
+  p->ghost_next = (p->ghost_next + 1) % NGHOST;
+}
+
+// If va is a ghost, forget it and return 1.
+int
+ghostHit(struct proc* p, char* va)
+{
+  int i;
+  for(i = 0; i < NGHOST; i++)
+    if(p->ghost[i] == va + PGSIZE){
+      p->ghost[i] = 0;
+      if(p->cold_target < p->max_psyc_pages - 1)
+        p->cold_target++;
+      return 1;
+    }
+  return 0;
+}
+
+char* clockpro(struct proc* p){
+  pte_t* pte;
+  int i, n, hot, dirty = -1;
+  for(hot = i = 0; i < p->phy_index; i++)
+    hot += p->ram_queue[i].hot;
+  hotHand(p, hot);
+  for(n = 0; n < 3*p->phy_index; n++, p->out_index = (p->out_index + 1) % p->phy_index){
+    if(n >= p->phy_index && dirty >= 0)
+      p->out_index = dirty;                       // no clean cold page in a whole sweep
+    i = p->out_index;
+    if(p->ram_queue[i].hot)
+      continue;
+    pte = p->ram_queue[i].pte;
+    if(*pte & PTE_A){
+      harvest(p, i);
+      if(p->ram_queue[i].test){                  // reused in its test period
+        p->ram_queue[i].hot = 1;
+        hotHand(p, ++hot);
+      } else
+        p->ram_queue[i].test = 1;
+      continue;
+    }
+    if(i != dirty && passDirty(p, i, &dirty))
+      continue;
+    if(p->ram_queue[i].test)
+      ghostAdd(p, p->ram_queue[i].va);
+    p->out_index = (i + 1) % p->phy_index;
+    return p->ram_queue[i].va;
+  }
+  return p->ram_queue[p->out_index].va;
+}
+
+// Multi-generational LRU. A page's nfua_counter is the generation
+// it was last seen used in, between p->min_seq, the oldest, and
+// p->max_seq, the youngest. Each aging pass opens a new generation,
+// while there are fewer than MGLRU_GENS, and moves the pages used
+// since into the youngest (mglru_update()). Eviction sweeps from
+// out_index for pages of the oldest generation, so the pages of one
+// pageOutCluster() batch come from a single sweep; a page found used
+// goes to the youngest generation instead. Once the oldest is empty
+// the next one becomes the oldest.
+char* mglru(struct proc* p){
+  pte_t* pte;
+  int i, n, dirty;
+  for(;;){
+    dirty = -1;
+    for(n = 0; n < p->phy_index; n++, p->out_index = (p->out_index + 1) % p->phy_index){
+      i = p->out_index;
+      if(p->ram_queue[i].nfua_counter != p->min_seq)
+        continue;
+      pte = p->ram_queue[i].pte;
+      if(*pte & PTE_A){
+        harvest(p, i);
+        p->ram_queue[i].nfua_counter = p->max_seq;
+        continue;
+      }
+      if(passDirty(p, i, &dirty))
+        continue;
+      p->out_index = (i + 1) % p->phy_index;
+      return p->ram_queue[i].va;
+    }
+    if(dirty >= 0){                              // the oldest generation has no clean page
+      p->out_index = (dirty + 1) % p->phy_index;
+      return p->ram_queue[dirty].va;
+    }
+    if(p->min_seq == p->max_seq)
+      p->max_seq++;                              // all in one generation and used: open the next
+    else
+      p->min_seq++;
+  }
+}
+
+// Shift a 1 into the aging counter of each page referenced since
+// the last pass, a 0 into the others.
+void NFU_update(struct proc* p){
+  int i;
+  pte_t * pte;
+  for(i = 0; i < p->phy_index; i++){
+    p->ram_queue[i].nfua_counter >>= 1;
+    pte = p->ram_queue[i].pte;
+    if(*pte & PTE_A){
+      harvest(p, i);
+      p->ram_queue[i].nfua_counter |= 1U << 31;
+    }
+  }
+}
+
+// Move a page referenced since the last pass ahead of an
+// unreferenced one in front of it.
+void aq_update(struct proc * p){
+  int i;
+  pte_t * pte1;
+  pte_t * pte2;
+  struct page temp;
+  for (i = 0 ; i + 1 < p->phy_index; i+=2){
+    pte1 = p->ram_queue[i].pte;
+    pte2 = p->ram_queue[i+1].pte;
+    if((*pte2 & PTE_A) && !(*pte1 & PTE_A)){ // switch places
+      temp = p->ram_queue[i];
+      p->ram_queue[i] = p->ram_queue[i+1];
+      p->ram_queue[i+1] = temp;
+    }
+  }
+  for(i = 0; i < p->phy_index; i++)
+    if(*p->ram_queue[i].pte & PTE_A)
+      harvest(p, i);
+}
+
+// Pages referenced since the last pass get p's current virtual
+// time (trap() counts it) as their last use.
+void ws_update(struct proc * p){
+  int i;
+  pte_t * pte;
+  for(i = 0; i < p->phy_index; i++){
+    pte = p->ram_queue[i].pte;
+    if(*pte & PTE_A){
+      harvest(p, i);
+      p->ram_queue[i].last_use = p->vtime;
+    }
+  }
+}
+
+// Open a new generation, if p has fewer than MGLRU_GENS, and move
+// the pages used since the last pass into the youngest one.
+void mglru_update(struct proc * p){
+  int i;
+  pte_t * pte;
+  if(p->max_seq - p->min_seq + 1 < MGLRU_GENS)
+    p->max_seq++;
+  for(i = 0; i < p->phy_index; i++){
+    pte = p->ram_queue[i].pte;
+    if(*pte & PTE_A){
+      harvest(p, i);
+      p->ram_queue[i].nfua_counter = p->max_seq;
+    }
+  }
+}
+
+// Replacement policies by number (policy.h). choose picks the page
+// to evict; tick, if any, harvests the reference bits in each aging
+// pass over the process (agetick()).
+// A new page starts with aging counter counter and, with front,
+// goes to the front of the ram_queue instead of the back.
+static struct policy {
+  char *name;
+  char* (*choose)(struct proc*);
+  void (*tick)(struct proc*);
+  uint counter;
+  int front;
+} policies[] = {
+[NFUA]      { "nfua",     nfua,     NFU_update, 0,          0 },
+[LAPA]      { "lapa",     lapa,     NFU_update, 0xFFFFFFFF, 0 },
+[SCFIFO]    { "scfifo",   SC_FIFO,  0,          0,          0 },
+[AQ]        { "aq",       aq,       aq_update,  0,          1 },
+[GLOBAL]    { "global",   SC_FIFO,  0,          0,          0 },  // globalPageOut() leaves out_index on the victim
+[WSCLOCK]   { "wsclock",  wsclock,  ws_update,  0,          0 },
+[CLOCKPRO]  { "clockpro", clockpro, 0,          0,          0 },
+[FIFO]      { "fifo",     fifo,     0,          0,          0 },
+[MGLRU]     { "mglru",    mglru,    mglru_update, 0,        0 },  // counter is p->max_seq, see addPage()
+};
+
+// Is pol a policy a process can use?
+int
+policyok(int pol)
+{
+  return pol > NONE && pol < NELEM(policies) && policies[pol].choose;
+}
+
+char*
+policyname(int pol)
+{
+  return policyok(pol) ? policies[pol].name : "none";
+}
+
+// Let p's policy look at the reference bits. p must be pinned.
+void
+policytick(struct proc *p)
+{
+  if(p->pid > 2 && policyok(p->policy) && policies[p->policy].tick)
+    policies[p->policy].tick(p);
+}
+
+// p's policy, after switching to the one setpolicy() asked for.
+// The caller must have p's ram_queue to itself: p is the current
+// process, or kswapd or the global hand has it pinned. What the old
+// policy kept per page means nothing to the new one, so every page
+// starts over as if just added. GLOBAL lifts the per-process limit;
+// leaving it puts the default back, as far as swap space allows.
+static struct policy*
+policy(struct proc *p)
+{
+  int i;
+  if(p->newpolicy != p->policy){
+    if(p->newpolicy == GLOBAL)
+      p->max_psyc_pages = MAX_RAM_QUEUE;
+    else if(p->policy == GLOBAL){
+      p->max_psyc_pages = MAX_PSYC_PAGES;
+      if(p->current_num_of_pages > p->max_psyc_pages + swaplimit())
+        p->max_psyc_pages = p->current_num_of_pages - swaplimit();
+    }
+    p->policy = p->newpolicy;
+    p->min_seq = p->max_seq = 0;
+    for(i = 0; i < p->phy_index; i++){
+      p->ram_queue[i].nfua_counter = policies[p->policy].counter;
+      p->ram_queue[i].last_use = p->vtime;
+      p->ram_queue[i].hot = 0;
+      p->ram_queue[i].test = 0;
+    }
+    p->out_index = 0;
+    p->hot_index = 0;
+    p->cold_target = p->max_psyc_pages / 4;
+    memset(p->ghost, 0, sizeof(p->ghost));
+    p->ghost_next = 0;
+  }
+  return &policies[p->policy];
+}
+
+// p's policy number, after any switch setpolicy() asked for.
+int
+policyof(struct proc *p)
+{
+  return policy(p) - policies;
+}
+
+char * choosePage(struct proc * p){
+  struct policy *pol = policy(p);
+  if(pol->choose == 0)
+    return 0;
+  return pol->choose(p);
+}
+
+// Index of the page at user address va in p's ram_queue, -1 if not resident.
+int findInRam(struct proc* p, char* va){
+  for(int i = 0; i < p->phy_index; i++){
+    if(p->ram_queue[i].va == va)
+      return i;
+  }
+  return -1;
+}
+
+void shiftPages(struct proc * p, char * mem){
+  for (int i = p->phy_index; i >= 1; i--)
+    p->ram_queue[i] = p->ram_queue[i-1];
+  p->ram_queue[0].va = mem;
+}
+
+// Put the page at user address va, mapped by pte, in p's ram_queue.
+// Returns its index there.
+int addPage(struct proc* p, char* va, pte_t* pte){
+  int i = p->phy_index;
+  struct policy *pol = policy(p);
+  if(i >= MAX_RAM_QUEUE)
+    panic("addPage: ram_queue full");
+  p->ram_queue[i].va = va;
+  if(pol->front){
+    shiftPages(p,va);
+    i = 0;
+  }
+  p->ram_queue[i].pte = pte;
+  p->ram_queue[i].nfua_counter = pol == &policies[MGLRU] ? p->max_seq : pol->counter;
+  p->ram_queue[i].slot = -1;                 // no swap copy yet
+  p->ram_queue[i].last_use = p->vtime;
+  p->ram_queue[i].hot = 0;
+  p->ram_queue[i].test = 0;
+  p->phy_index++;
+  return i;
+}
+
+// Take entry i out of p's ram_queue, keeping the order of the rest.
+void removePage(struct proc* p, int i){
+  if(p->out_index > i)
+    p->out_index--;
+  for(; i < p->phy_index - 1; i++)
+    p->ram_queue[i] = p->ram_queue[i+1];
+  p->phy_index--;
+  p->ram_queue[p->phy_index].va = 0;
+  if(p->out_index >= p->phy_index)
+    p->out_index = 0;
+}
@@ -0,0 +1,13 @@
+// Page replacement policies, for setpolicy() and SELECTION=.
+#define NONE      0
+#define NFUA      1
+#define LAPA      2
+#define SCFIFO    3
+#define AQ        4
+#define GLOBAL    5
+#define WSCLOCK   6
+#define CLOCKPRO  7
+#define FIFO      9
+#define MGLRU    10
+
+#define CLEANFIRST 0x100   // or'ed into a policy: of pages it ranks alike, clean ones go first
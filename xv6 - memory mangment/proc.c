@@ -6,13 +6,8 @@
 #include "x86.h"
 #include "proc.h"
 #include "spinlock.h"
+#include "policy.h"
 
-#define NONE 8
-#define NFUA 1
-#define LAPA 2
-#define SCFIFO 3
-#define AQ 4
-#define FIFO 9
 #define TRUE 1
 #define FALSE 0
 
@@ -22,6 +17,11 @@ struct {
 } ptable;
 
 static struct proc *initproc;
+static struct proc *kswapdproc;
+static int kswapdwanted;
+static volatile int kswapdkick;       // set by kswapdwake(), the scheduler does the wakeup
+static int defpolicy = SELECTION;     // policy of new processes
+static int defclean;                  // and if they run its CLEANFIRST variant
 
 struct spinlock refLock;
 
@@ -33,8 +33,7 @@ static void wakeup1(void *chan);
 // static char buffer[PGSIZE]; (looks like its working with buffer = kalloc for now)
 uint pg_accCount[PHYSTOP >> PGSHIFT];
 
-void NFU_update(struct proc* p);
-void aq_update(struct proc * p);
+void pff_update(struct proc * p);
 
 void
 pinit(void)
@@ -81,6 +80,16 @@ myproc(void) {
   return p;
 }
 
+// Free the ram_queue that allocproc() gave p, if it has one.
+static void
+freeRamQueue(struct proc *p)
+{
+  if(p->ram_queue){
+    kfree((char*)p->ram_queue);
+    p->ram_queue = 0;
+  }
+}
+
 //PAGEBREAK: 32
 // Look in the process table for an UNUSED proc.
 // If found, change state to EMBRYO and initialize
@@ -114,21 +123,42 @@ found:
   }
   p->numOfPageFaults = 0;
   p->numOfPageOut = 0;
+  p->numOfSwapWrites = 0;
+  p->vmbusy = 0;
+  p->reclaiming = 0;
+  p->vtime = 0;
+  p->pff_quanta = 0;
+  p->pff_faults = 0;
+  p->min_seq = 0;
+  p->max_seq = 0;
   if(p->pid > 2){
       p->physical_num_of_pages = 0;       
       p->phy_index = 0;
       p->current_num_of_pages = 0;
       p->out_index =  0;
-      p->swapMetaCounter = 0;
-    if(createSwapFile(p) < 0)
-      cprintf("can't create swap file\n");
-    for(int j1 = 0 ; j1 < 16 ; j1++){ // ram queue
-      p->ram_queue[j1].va = 0;
-                                      // we need to intilize counter?
-    }
-    for(int j2 = 0 ; j2< 16 ; j2++){   // meta-data intiliize
-      p->meta[j2].location = 0;
+      p->swap_num_of_pages = 0;
+      p->policy = p->newpolicy = defpolicy;
+      p->cleanfirst = defclean;
+      if(p->policy == GLOBAL)
+        p->max_psyc_pages = MAX_RAM_QUEUE;  // GLOBAL_PSYC_PAGES is the limit that counts
+      else
+        p->max_psyc_pages = MAX_PSYC_PAGES;
+      p->total_psyc_pages = TOTAL_PSYC_PAGES;
+      if(p->total_psyc_pages > p->max_psyc_pages + swaplimit())
+        p->total_psyc_pages = p->max_psyc_pages + swaplimit();
+      p->hot_index = 0;
+      p->cold_target = p->max_psyc_pages / 4;
+      memset(p->ghost, 0, sizeof(p->ghost));
+      p->ghost_next = 0;
+    if((p->ram_queue = (struct page*)kalloc()) == 0){
+      kfree(p->kstack);
+      p->kstack = 0;
+      p->state = UNUSED;
+      return 0;
     }
+    if(swapopen(p) < 0)
+      cprintf("can't create swap file\n");
+    memset(p->swap_bitmap, 0, sizeof(p->swap_bitmap));   // all slots free
   }
 
   sp = p->kstack + KSTACKSIZE;
@@ -198,18 +228,90 @@ growproc(int n)
   struct proc *curproc = myproc();
 
   sz = curproc->sz;
+  curproc->vmbusy++;
   if(n > 0){
-    if((sz = allocuvm(curproc->pgdir, sz, sz + n)) == 0)
-      return -1;
+    sz = allocuvm(curproc->pgdir, sz, sz + n);
   } else if(n < 0){
-    if((sz = deallocuvm(curproc->pgdir, sz, sz + n)) == 0)
-      return -1;
+    sz = deallocuvm(curproc->pgdir, sz, sz + n);
   }
+  curproc->vmbusy--;
+  if(sz == 0)
+    return -1;
   curproc->sz = sz;
   switchuvm(curproc);
   return 0;
 }
 
+// Page-fault frequency thresholds, see pff_update().
+static int pffLow = PFF_LOW;
+static int pffHigh = PFF_HIGH;
+
+// Set the PFF thresholds for all processes.
+// Return 0 on success, -1 on bad thresholds.
+int
+setpff(int low, int high)
+{
+  if(low < 0 || high < low)
+    return -1;
+  pffLow = low;
+  pffHigh = high;
+  return 0;
+}
+
+// Replace pages with policy pol (policy.h) from now on: in the
+// current process and the children it forks, or with all set, in
+// every process and those created later. Each process switches the
+// next time it pages in or out. With CLEANFIRST or'ed into pol
+// clean pages go first. Return 0 on success, -1 on a bad policy.
+int
+setpolicy(int pol, int all)
+{
+  struct proc *p;
+  int clean = (pol & CLEANFIRST) != 0;
+
+  pol &= ~CLEANFIRST;
+  if(!policyok(pol))
+    return -1;
+  if(!all){
+    if(myproc()->pid <= 2)
+      return -1;
+    myproc()->newpolicy = pol;
+    myproc()->cleanfirst = clean;
+    return 0;
+  }
+  acquire(&ptable.lock);
+  defpolicy = pol;
+  defclean = clean;
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+    if(p->pid > 2 && p->state != UNUSED){
+      p->newpolicy = pol;
+      p->cleanfirst = clean;
+    }
+  release(&ptable.lock);
+  return 0;
+}
+
+// Set how many pages the current process may keep in RAM and how
+// many it may have in all. Pages over the new RAM limit are paged
+// out right away. Return 0 on success, -1 on bad limits.
+int
+setpaging(int resident, int total)
+{
+  struct proc *curproc = myproc();
+
+  if(curproc->pid <= 2 || resident < MIN_PSYC_PAGES || resident > MAX_RAM_QUEUE)
+    return -1;
+  if(total < resident || total > resident + swaplimit() || total < curproc->current_num_of_pages)
+    return -1;
+  curproc->vmbusy++;
+  curproc->max_psyc_pages = resident;
+  curproc->total_psyc_pages = total;
+  while(curproc->physical_num_of_pages > resident)
+    pageOutCluster(curproc, curproc->physical_num_of_pages - resident);
+  curproc->vmbusy--;
+  return 0;
+}
+
 
 
 // Create a new process copying p as the parent.
@@ -221,31 +323,57 @@ fork(void)
   int i, pid;
   struct proc *np;
   struct proc *curproc = myproc();
-  char * buffer = 0;
-  uint a = 0;
 
   // Allocate process.
   if((np = allocproc()) == 0){
     return -1;
   }
   if(curproc->pid > 2){   // do cow for all processes except init and shell
+    curproc->vmbusy++;
     if((np->pgdir = cowuvm(curproc->pgdir, curproc->sz)) == 0){      
+      curproc->vmbusy--;
+      freeRamQueue(np);
       kfree(np->kstack);
       np->kstack = 0;
       np->state = UNUSED;
       return -1;
     }
-    // copy the swapFile
-    buffer = kalloc(); 
-    uint num = curproc->current_num_of_pages - curproc->physical_num_of_pages;      // number of pages in swap file
-    for(a = 0; a < num * PGSIZE ; a+= PGSIZE){
-      readFromSwapFile(curproc,buffer,a,PGSIZE);
-      writeToSwapFile(np,buffer,a,PGSIZE);
+    // the child maps the same pages, at the same addresses
+    for(i = 0; i < curproc->phy_index; i++){
+      np->ram_queue[i] = curproc->ram_queue[i];
+      np->ram_queue[i].pte = walkpgdir(np->pgdir, np->ram_queue[i].va, 0);
+      np->ram_queue[i].slot = -1;          // the swap copies stay the parent's
+    }
+    np->vtime = curproc->vtime;            // the copied last_use times stay meaningful
+    np->cold_target = curproc->cold_target;
+    np->min_seq = curproc->min_seq;
+    np->max_seq = curproc->max_seq;
+    np->policy = curproc->policy;          // the copied ram_queue is kept the parent's way
+    np->newpolicy = curproc->newpolicy;
+    np->cleanfirst = curproc->cleanfirst;
+    np->max_psyc_pages = curproc->max_psyc_pages;
+    np->total_psyc_pages = curproc->total_psyc_pages;
+    np->phy_index = curproc->phy_index;
+    np->out_index = curproc->out_index;
+    np->physical_num_of_pages = curproc->physical_num_of_pages;
+    np->current_num_of_pages = curproc->current_num_of_pages;
+    // copy the swapped out pages
+    np->sz = curproc->sz;
+    if(swapdup(np, curproc) < 0){
+      curproc->vmbusy--;
+      swapclose(np);
+      freevm(np->pgdir);
+      freeRamQueue(np);
+      kfree(np->kstack);
+      np->kstack = 0;
+      np->state = UNUSED;
+      return -1;
     }
-    kfree(buffer);
+    curproc->vmbusy--;
   }
   else{
       if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0){ 
+        freeRamQueue(np);
         kfree(np->kstack);
         np->kstack = 0;
         np->state = UNUSED;
@@ -291,7 +419,8 @@ exit(void)
     panic("init exiting");
 
   if(curproc->pid > 2){
-      removeSwapFile(curproc);
+      curproc->vmbusy++;             // for good, p is done with paging
+      swapclose(curproc);
   }
 
   // Close all open files.
@@ -355,6 +484,7 @@ wait(void)
         kfree(p->kstack);  // refCount not relevant
         p->kstack = 0;
         freevm(p->pgdir);
+        freeRamQueue(p);
         p->pid = 0;
         p->parent = 0;
         p->name[0] = 0;
@@ -397,8 +527,13 @@ scheduler(void)
 
     // Loop over process table looking for process to run.
     acquire(&ptable.lock);
+    if(kswapdkick && kswapdproc){
+      kswapdkick = 0;
+      kswapdwanted = 1;
+      wakeup1(&kswapdwanted);
+    }
     for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->state != RUNNABLE)
+      if(p->state != RUNNABLE || p->reclaiming)
         continue;
 
       // Switch to chosen process.  It is the process's job
@@ -409,14 +544,18 @@ scheduler(void)
       p->state = RUNNING;
       
       swtch(&(c->scheduler), p->context);
-      #if SELECTION == NFUA || SELECTION == LAPA
-        NFU_update(p); // update nfua counter
-      #endif
 
-      #if SELECTION == AQ
-        aq_update(p);
+      #if PFF == TRUE
+        pff_update(p);
       #endif
 
+      // p is off the CPU now; if it is close to its max_psyc_pages
+      // let kswapd trim it before its next fault.
+      if(p->pid > 2 && p->physical_num_of_pages >= p->max_psyc_pages - KSWAPD_MARGIN && kswapdproc){
+        kswapdwanted = 1;
+        wakeup1(&kswapdwanted);
+      }
+
       switchkvm();
       
       // Process is done running for now.
@@ -597,7 +736,7 @@ procdump(void)
     else
       state = "???";
     
-    cprintf("%d %s %d %d %d %d %s\n", p->pid, state, p->physical_num_of_pages, p->swapMetaCounter, p->numOfPageFaults,p->numOfPageOut,p->name);
+    cprintf("%d %s %d/%d %d %d %d %d %s %s%s\n", p->pid, state, p->physical_num_of_pages, p->max_psyc_pages, p->swap_num_of_pages, p->numOfPageFaults,p->numOfPageOut,p->numOfSwapWrites,p->name, policyname(p->policy), p->cleanfirst ? "+clean" : "");
     if(p->state == SLEEPING){
       getcallerpcs((uint*)p->context->ebp+2, pc);
       for(i=0; i<10 && pc[i] != 0; i++)
@@ -605,34 +744,251 @@ procdump(void)
     }
     cprintf("%d / %d free page frames in the system\n",getCurrentNumOfFreePages(), getTotalNumOfFreePages());
   }
+  cprintf("%d / %d swap read-ahead hits / misses\n", getRaHits(), getRaMisses());
+  cprintf("%d compressed pages in %d frames\n", getZramPages(), getZramFrames());
+  cprintf("%d zero pages evicted without a write\n", getZeroPageOuts());
+  cprintf("%d pages written to swap\n", getSwapWrites());
+  slabdump();
+#if PFF == TRUE
+  cprintf("pff: %d to %d faults per %d quanta\n", pffLow, pffHigh, PFF_WINDOW);
+#endif
 }
 
-void NFU_update(struct proc* p){
+//PAGEBREAK: 40
+// kswapd: evicts pages in the background so that allocuvm() and
+// pageFault() usually find a free resident slot and a free frame
+// without waiting for a swap write. It is a kernel thread with no
+// user memory, scheduled like any other process.
+
+// Pick a process for kswapd and how many of its pages to evict.
+// Only a process that is not running and not in the middle of its
+// own paging is eligible. Must hold ptable.lock.
+static struct proc*
+reclaimvictim(int *n)
+{
+  struct proc *p, *big = 0;
+  int excess;
+
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+    if(p->pid <= 2 || p->vmbusy || p->reclaiming || p->phy_index == 0)
+      continue;
+    if(p->state != RUNNABLE && p->state != SLEEPING)
+      continue;
+    // near max_psyc_pages: make room before the next fault needs it
+    excess = p->physical_num_of_pages - (p->max_psyc_pages - KSWAPD_MARGIN);
+    if(excess > 0){
+      *n = excess;
+      return p;
+    }
+    if(big == 0 || p->physical_num_of_pages > big->physical_num_of_pages)
+      big = p;
+  }
+  // short of frames: take a cluster from the largest resident set
+  if(getCurrentNumOfFreePages() < KSWAPD_HIGH && big && big->physical_num_of_pages > 1){
+    *n = big->physical_num_of_pages - 1;
+    return big;
+  }
+  return 0;
+}
+
+static void
+kswapd(void)
+{
+  struct proc *p;
+  int n;
+
+  // Still holding ptable.lock from scheduler.
+  release(&ptable.lock);
+
+  for(;;){
+    acquire(&ptable.lock);
+    while((p = reclaimvictim(&n)) == 0){
+      kswapdwanted = 0;
+      sleep(&kswapdwanted, &ptable.lock);
+    }
+    p->reclaiming = 1;               // scheduler leaves p alone until we are done
+    release(&ptable.lock);
+
+    pageOutCluster(p, n);
+
+    acquire(&ptable.lock);
+    p->reclaiming = 0;
+    release(&ptable.lock);
+  }
+}
+
+// Global replacement (policy GLOBAL) charges the resident pages of
+// all processes using it to one pool of GLOBAL_PSYC_PAGES. When it
+// is full, a clock hand sweeps their ram_queues, one process after
+// the other, for a page to evict (globalPageOut() in vm.c). As with kswapd, the pages of another process are only
+// taken while it is off the CPU and pinned.
+
+static int ghand;                    // process the global clock hand is in
+
+// Resident pages charged to the global pool.
+int
+residentpages(void)
+{
+  struct proc *p;
+  int n = 0;
+
+  acquire(&ptable.lock);
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+    if(p->pid > 2 && p->state != UNUSED && p->state != ZOMBIE && p->policy == GLOBAL)
+      n += p->physical_num_of_pages;
+  release(&ptable.lock);
+  return n;
+}
+
+// The next process at or after the clock hand whose pages can be
+// taken now: self, or one that is not running and not paging. It
+// is pinned until clockdone(). Another process only qualifies with
+// the raw swap area; a swap file write could wait on a log slot,
+// buffer or inode lock that the pinned process holds while asleep.
+// Returns 0 if there is none.
+struct proc*
+clockproc(struct proc *self)
+{
+  struct proc *p;
+  int i;
+
+  acquire(&ptable.lock);
+  for(i = 0; i < NPROC; i++, ghand = (ghand + 1) % NPROC){
+    p = &ptable.proc[ghand];
+    if(p->pid <= 2 || p->phy_index == 0 || p->policy != GLOBAL)
+      continue;
+    if(p != self){
+      if(!swapdev || p->vmbusy || p->reclaiming || (p->state != RUNNABLE && p->state != SLEEPING))
+        continue;
+      p->reclaiming = 1;
+    }
+    release(&ptable.lock);
+    return p;
+  }
+  release(&ptable.lock);
+  return 0;
+}
+
+// Unpin p. If the hand went all through p, move it on.
+void
+clockdone(struct proc *p, int passed)
+{
+  acquire(&ptable.lock);
+  if(p != myproc())
+    p->reclaiming = 0;
+  if(passed && &ptable.proc[ghand] == p)
+    ghand = (ghand + 1) % NPROC;
+  release(&ptable.lock);
+}
+
+// Start kswapd. It takes a proc slot but no pid, so the
+// pid numbering of init and the shell is unchanged.
+// Only with the raw swap area: kswapd pins a process that may be
+// asleep, and paging out to a swap file takes log space, buffers and
+// the inode lock, which that process may hold. With swap files every
+// process evicts its own pages.
+void
+kswapdinit(void)
+{
+  struct proc *p;
+  char *sp;
+
+  if(!swapdev)
+    return;
+  acquire(&ptable.lock);
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+    if(p->state == UNUSED)
+      break;
+  if(p == &ptable.proc[NPROC])
+    panic("kswapdinit: no proc");
+  p->state = EMBRYO;
+  p->pid = 0;
+  release(&ptable.lock);
+
+  if((p->kstack = kalloc()) == 0 || (p->pgdir = setupkvm()) == 0)
+    panic("kswapdinit: out of memory");
+  p->vmbusy = 0;
+  p->reclaiming = 0;
+  p->physical_num_of_pages = 0;
+  p->phy_index = 0;
+  sp = p->kstack + KSTACKSIZE;
+  sp -= sizeof *p->context;
+  p->context = (struct context*)sp;
+  memset(p->context, 0, sizeof *p->context);
+  p->context->eip = (uint)kswapd;
+  safestrcpy(p->name, "kswapd", sizeof(p->name));
+
+  acquire(&ptable.lock);
+  kswapdproc = p;
+  p->state = RUNNABLE;
+  release(&ptable.lock);
+}
+
+// Tell kswapd that free frames are running low. kalloc() calls this
+// with other locks held (vm.c's lock, zram.lock) that wait() and
+// freevm() take under ptable.lock, so it takes no lock: it leaves a
+// flag the scheduler's next pass turns into a wakeup.
+void
+kswapdwake(void)
+{
+  kswapdkick = 1;
+}
+
+// Reference bits are harvested by a pass the timer drives (agetick()
+// on CPU 0), so pages age with time rather than with how often a
+// process yields, and the scheduler does no page table work under
+// ptable.lock. Each tick the pass moves over the next AGEBATCH proc
+// slots, which ages every process once per AGETICKS ticks. Like
+// kswapd, it only takes a process that is off the CPU and not paging,
+// pins it, and ages its pages with ptable.lock released.
+
+#define AGEBATCH ((NPROC + AGETICKS - 1) / AGETICKS)
+
+static int agehand;                  // next proc slot to age
+
+void
+agetick(void)
+{
+  struct proc *p;
   int i;
-  pte_t * pte;
-    for(i = 0; i < p->physical_num_of_pages; i++){
-      p->ram_queue[i].nfua_counter >>= 1;
-      pte = walkpgdir(p->pgdir,p->ram_queue[i].va,0);
-      if(*pte & PTE_A)
-         p->ram_queue[i].nfua_counter |= 2^31; 
-   }   
-}
-
-void aq_update(struct proc * p){
-  int i,check;
-  pte_t * pte1;
-  pte_t * pte2;
-  struct page temp;
-  for (i = 0 ; i < MAX_PSYC_PAGES; i+=2){
-    pte1 = walkpgdir(p->pgdir,p->ram_queue[i].va,0);
-    pte2 = walkpgdir(p->pgdir,p->ram_queue[i+1].va,0);
-    check = ! (*pte1 & PTE_A);
-    if( (*pte2 & PTE_A) && (check)){ // switch places
-      temp.va = p->ram_queue[i].va;
-      temp.nfua_counter = p->ram_queue[i].nfua_counter;
-      p->ram_queue[i] = p->ram_queue[i+1];
-      p->ram_queue[i+1] = temp;
+
+  for(i = 0; i < AGEBATCH; i++){
+    acquire(&ptable.lock);
+    p = &ptable.proc[agehand];
+    agehand = (agehand + 1) % NPROC;
+    if(p->pid <= 2 || p->vmbusy || p->reclaiming || (p->state != RUNNABLE && p->state != SLEEPING)){
+      release(&ptable.lock);
+      continue;
     }
+    p->reclaiming = 1;
+    release(&ptable.lock);
+
+    policytick(p);     // aging counters, AQ order, WSCLOCK's last uses
+
+    acquire(&ptable.lock);
+    p->reclaiming = 0;
+    release(&ptable.lock);
   }
 }
 
+// Page-fault frequency: every PFF_WINDOW quanta p has run, give it
+// PFF_STEP more resident pages if it faulted more than pffHigh
+// times, and PFF_STEP fewer if it faulted fewer than pffLow times.
+// A process left over its new limit is trimmed by kswapd, which the
+// scheduler wakes for it right after this.
+void pff_update(struct proc * p){
+  int faults;
+  if(p->pid <= 2 || ++p->pff_quanta < PFF_WINDOW)
+    return;
+  faults = p->numOfPageFaults - p->pff_faults;
+  p->pff_quanta = 0;
+  p->pff_faults = p->numOfPageFaults;
+  if(faults > pffHigh){
+    if(p->max_psyc_pages + PFF_STEP <= MAX_RAM_QUEUE && getCurrentNumOfFreePages() > KSWAPD_HIGH)
+      p->max_psyc_pages += PFF_STEP;
+  } else if(faults < pffLow){
+    if(p->max_psyc_pages >= MIN_PSYC_PAGES + PFF_STEP
+       && p->current_num_of_pages <= p->max_psyc_pages - PFF_STEP + swaplimit())
+      p->max_psyc_pages -= PFF_STEP;
+  }
+}
@@ -1,6 +1,8 @@
 
-#define MAX_PSYC_PAGES 16
-#define TOTAL_PSYC_PAGES 32
+#define MAX_PSYC_PAGES 16      // default p->max_psyc_pages
+#define TOTAL_PSYC_PAGES 1024  // default p->total_psyc_pages
+#define MIN_PSYC_PAGES 4       // an instruction can touch this many pages
+#define MAX_SWAP_PAGES 32      // bound on the pages of one swap file
 
 
 // Per-CPU state
@@ -37,16 +39,20 @@ struct context {
   uint eip;
 };
 
-struct metaData{
-  int location; // multiply of PGSIZE - location in swapFile
-  char * va;    // virtual address of page
-};
-
 struct page {
   char* va;
-  uint nfua_counter;
+  pte_t* pte;                  // its PTE, so aging needs no walkpgdir()
+  uint nfua_counter;           // aging counter; MGLRU: generation it was last used in
+  int slot;                    // swap slot still holding a copy, -1 if none
+  uint last_use;               // p->vtime the page was last seen referenced
+  char hot;                    // CLOCKPRO: reused, only the hot hand demotes it
+  char test;                   // CLOCKPRO: cold page in its test period
 };
 
+#ifndef MAX_RAM_QUEUE
+#define MAX_RAM_QUEUE (PGSIZE/sizeof(struct page))   // ram_queue is one page
+#endif
+
 enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
 // Per-process state
@@ -68,13 +74,30 @@ struct proc {
   struct file *swapFile;       // page file
   uint physical_num_of_pages;  // physical pages
   uint current_num_of_pages;   // total pages
-  struct metaData meta[16];    // pages in swapFile  
-  struct page ram_queue [16];  // pages the process has in RAM. fifo for now, will update in task 3
+  uint swap_num_of_pages;      // pages in swap, their slot is kept in the PTE
+  uint swap_bitmap[(MAX_SWAP_PAGES+31)/32]; // slots in use in swapFile
+  struct page *ram_queue;      // pages the process has in RAM, kalloc()ed
+  uint max_psyc_pages;         // pages p may have in RAM before it pages out
+  uint total_psyc_pages;       // pages p may have in all
   int phy_index;               // where the next page should be placed
   int out_index;               // what page should be out from the queue
-  int swapMetaCounter;         // how many pages are in swapFile
   int numOfPageFaults;
   int numOfPageOut;
+  int numOfSwapWrites;         // pages paged out that had to be written to swap
+  int vmbusy;                  // >0 while p changes its own paging state
+  int reclaiming;              // kswapd is evicting p's pages, don't run p
+  uint vtime;                  // ticks p has run, WSCLOCK's clock
+  int hot_index;               // CLOCKPRO's hot hand (out_index is the cold one)
+  int cold_target;             // CLOCKPRO: resident slots for cold pages
+  char *ghost[NGHOST];         // CLOCKPRO: recently evicted cold pages + PGSIZE, a ring
+  int ghost_next;
+  int pff_quanta;              // quanta run in the current PFF window
+  int pff_faults;              // numOfPageFaults when the window began
+  uint min_seq;                // MGLRU: oldest generation
+  uint max_seq;                // MGLRU: youngest generation
+  int policy;                  // replacement policy, see policy.h
+  int newpolicy;               // policy asked for by setpolicy()
+  int cleanfirst;              // run the policy's CLEANFIRST variant
 };
 
 
@@ -0,0 +1,224 @@
+// Slab allocator for kernel objects smaller than a page.
+//
+// A cache hands out objects of one size. It cuts kalloc()ed pages,
+// the slabs, into objects. A slab starts with a struct slab that
+// chains its free objects through their first word, so
+// kmem_cache_free() finds the slab by rounding the object down to
+// its page. Slabs with free objects are on the cache's partial
+// list. A slab that empties goes back to kalloc(), unless the cache
+// has no spare slab yet.
+// In front of the slabs each CPU has a magazine of up to SLABMAG
+// free objects, used with interrupts off and no lock. An empty
+// magazine refills, and a full one gives half back, under the
+// cache lock.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "spinlock.h"
+
+struct slab {
+  struct slab *next;           // on the partial list
+  struct slab *prev;
+  struct kmem_cache *cache;
+  void **free;                 // free objects
+  int inuse;
+};
+
+struct magazine {
+  int n;
+  void *obj[SLABMAG];
+};
+
+struct kmem_cache {
+  struct spinlock lock;
+  char *name;
+  uint size;                   // object size, a multiple of 4
+  int perslab;                 // objects in one slab
+  struct slab *partial;        // slabs with free objects
+  struct slab *spare;          // an empty slab kept for the next one
+  int nslabs;
+  int nobjs;                   // objects out of the slabs, magazines too
+  struct magazine mag[NCPU];
+};
+
+#define SLABHDR ((sizeof(struct slab) + 3) & ~3)
+
+struct {
+  struct spinlock lock;
+  struct kmem_cache cache[NSLABCACHE];
+  int n;
+} slabs;
+
+void
+slabinit(void)
+{
+  initlock(&slabs.lock, "slabs");
+}
+
+// A cache of objects of size bytes, which must leave room for
+// at least one in a page. Caches are never destroyed.
+struct kmem_cache*
+kmem_cache_create(char *name, uint size)
+{
+  struct kmem_cache *c;
+
+  size = (size + 3) & ~3;
+  if(size < sizeof(void*))
+    size = sizeof(void*);
+  if(size > PGSIZE - SLABHDR)
+    panic("kmem_cache_create: too big");
+  acquire(&slabs.lock);
+  if(slabs.n == NSLABCACHE)
+    panic("kmem_cache_create: too many caches");
+  c = &slabs.cache[slabs.n++];
+  release(&slabs.lock);
+  initlock(&c->lock, name);
+  c->name = name;
+  c->size = size;
+  c->perslab = (PGSIZE - SLABHDR) / size;
+  return c;
+}
+
+static void
+partialadd(struct kmem_cache *c, struct slab *s)
+{
+  s->prev = 0;
+  s->next = c->partial;
+  if(s->next)
+    s->next->prev = s;
+  c->partial = s;
+}
+
+static void
+partialremove(struct kmem_cache *c, struct slab *s)
+{
+  if(s->prev)
+    s->prev->next = s->next;
+  else
+    c->partial = s->next;
+  if(s->next)
+    s->next->prev = s->prev;
+}
+
+// A slab with all objects free, the spare one or a new page.
+static struct slab*
+slabgrow(struct kmem_cache *c)
+{
+  struct slab *s;
+  char *obj;
+  int i;
+
+  if((s = c->spare) != 0){
+    c->spare = 0;
+    return s;
+  }
+  if((s = (struct slab*)kalloc()) == 0)
+    return 0;
+  s->cache = c;
+  s->inuse = 0;
+  s->free = 0;
+  obj = (char*)s + SLABHDR + (c->perslab - 1) * c->size;
+  for(i = 0; i < c->perslab; i++, obj -= c->size){
+    *(void**)obj = s->free;
+    s->free = (void**)obj;
+  }
+  c->nslabs++;
+  return s;
+}
+
+// Take an object from the slabs. Caller holds c->lock.
+static void*
+slaballoc(struct kmem_cache *c)
+{
+  struct slab *s;
+  void **obj;
+
+  if((s = c->partial) == 0){
+    if((s = slabgrow(c)) == 0)
+      return 0;
+    partialadd(c, s);
+  }
+  obj = s->free;
+  s->free = *obj;
+  s->inuse++;
+  if(s->free == 0)
+    partialremove(c, s);
+  c->nobjs++;
+  return obj;
+}
+
+// Give an object back to its slab. Caller holds c->lock.
+static void
+slabfree(struct kmem_cache *c, void *obj)
+{
+  struct slab *s;
+
+  s = (struct slab*)PGROUNDDOWN((uint)obj);
+  if(s->cache != c || ((char*)obj - (char*)s - SLABHDR) % c->size)
+    panic("kmem_cache_free: not from this cache");
+  if(s->free == 0)
+    partialadd(c, s);
+  *(void**)obj = s->free;
+  s->free = obj;
+  s->inuse--;
+  c->nobjs--;
+  if(s->inuse > 0)
+    return;
+  partialremove(c, s);
+  if(c->spare == 0)
+    c->spare = s;
+  else {
+    c->nslabs--;
+    kfree((char*)s);
+  }
+}
+
+// Allocate an object of c. Returns 0 if there is no memory.
+void*
+kmem_cache_alloc(struct kmem_cache *c)
+{
+  struct magazine *m;
+  void *obj;
+
+  pushcli();
+  m = &c->mag[cpuid()];
+  if(m->n == 0){                         // empty, get half a magazine
+    acquire(&c->lock);
+    while(m->n < SLABMAG/2 && (obj = slaballoc(c)) != 0)
+      m->obj[m->n++] = obj;
+    release(&c->lock);
+  }
+  obj = m->n > 0 ? m->obj[--m->n] : 0;
+  popcli();
+  return obj;
+}
+
+void
+kmem_cache_free(struct kmem_cache *c, void *obj)
+{
+  struct magazine *m;
+
+  pushcli();
+  m = &c->mag[cpuid()];
+  if(m->n == SLABMAG){                   // full, give half back
+    acquire(&c->lock);
+    while(m->n > SLABMAG/2)
+      slabfree(c, m->obj[--m->n]);
+    release(&c->lock);
+  }
+  m->obj[m->n++] = obj;
+  popcli();
+}
+
+// Print the use of each cache, for procdump().
+void
+slabdump(void)
+{
+  struct kmem_cache *c;
+
+  for(c = slabs.cache; c < &slabs.cache[slabs.n]; c++)
+    cprintf("%s cache: %d objects of %d bytes in %d slabs\n", c->name, c->nobjs, c->size, c->nslabs);
+}
@@ -0,0 +1,317 @@
+// Swap space for pages evicted by pageOut().
+//
+// Pages go either to a raw area on disk 1 right after the file
+// system, or to the per-process swap files in fs.c. The raw area
+// is addressed by slot, one page per slot, and a global bitmap
+// tracks which slots are in use. It has no journal and no buffer
+// cache: a page moves with one 8-sector disk command. A slot there
+// is reference counted, so fork() shares it instead of copying;
+// whoever faults the page in gets a private frame and drops a
+// reference.
+// swapinit() picks the raw area at boot if the disk has it.
+// In front of either, swapstore() keeps pages compressed in RAM
+// (zram.c); those get the slots from ZRAMSLOT up. A page of zeros
+// is not stored anywhere, it gets ZEROSLOT.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "fs.h"
+
+#define TRUE 1
+#define FALSE 0
+
+#define SLOTSECTORS (PGSIZE/BSIZE)        // 1 fs block = 1 disk sector
+#define NSWAPSLOTS  (SWAPSIZE/SLOTSECTORS)
+#define FILESLOTS   (MAXFILE*BSIZE/PGSIZE)  // what one swap file can hold
+
+struct {
+  struct spinlock lock;
+  int nslots;                  // usable slots in the raw area
+  uint map[NSWAPSLOTS/32];     // bit set if slot is in use
+  uchar ref[NSWAPSLOTS];       // page tables that point at the slot
+} swap;
+
+int swapdev;                   // if non-zero, swap to the raw area
+uint zeroPageOuts;             // zero pages evicted without a write
+
+void
+swapinit(void)
+{
+  initlock(&swap.lock, "swap");
+  zraminit();
+  swap.nslots = ideswapsize() / SLOTSECTORS;
+  if(swap.nslots > NSWAPSLOTS)
+    swap.nslots = NSWAPSLOTS;
+#if SWAP_DEVICE == TRUE
+  swapdev = swap.nslots > 0;
+#endif
+  if(swapdev)
+    cprintf("swap: %d slots on raw swap area\n", swap.nslots);
+  else
+    cprintf("swap: using swap files\n");
+#if ZRAM == TRUE
+  cprintf("swap: compressed pool of up to %d frames\n", ZRAMPAGES);
+#endif
+}
+
+// Most pages one process can have in swap space.
+int
+swaplimit(void)
+{
+  return swapdev ? swap.nslots : FILESLOTS;
+}
+
+// Set up swap space for a new process.
+int
+swapopen(struct proc *p)
+{
+  if(swapdev)
+    return 0;
+  return createSwapFile(p);
+}
+
+// Release all swap space held by p and clear its paged out PTEs.
+int
+swapclose(struct proc *p)
+{
+  pte_t *pte;
+  uint a;
+
+  swapdrop(p);
+  for(a = 0; a < p->sz && p->swap_num_of_pages > 0; a += PGSIZE){
+    if((pte = walkpgdir(p->pgdir, (char*)a, 0)) == 0 || !(*pte & PTE_PG))
+      continue;
+    swapfree(p, PTE_SLOT(*pte));
+    *pte = 0;
+    p->swap_num_of_pages--;
+  }
+  if(!swapdev)
+    return removeSwapFile(p);
+  return 0;
+}
+
+// Free the slots that still hold copies of p's resident pages.
+void
+swapdrop(struct proc *p)
+{
+  int i;
+
+  for(i = 0; i < p->phy_index; i++)
+    if(p->ram_queue[i].slot >= 0){
+      swapfree(p, p->ram_queue[i].slot);
+      p->ram_queue[i].slot = -1;
+    }
+}
+
+// Allocate n consecutive slots for pages of p, lowest free run
+// first. Returns the first slot, or -1 if there is no such run.
+int
+swapalloc(struct proc *p, int n)
+{
+  uint *map;
+  int i, run, nslots;
+
+  if(swapdev){
+    map = swap.map;
+    nslots = swap.nslots;
+    acquire(&swap.lock);
+  } else {
+    map = p->swap_bitmap;
+    nslots = FILESLOTS;
+  }
+  run = 0;
+  for(i = 0; i < nslots; i++){
+    if(i % 32 == 0 && map[i/32] == 0xFFFFFFFF){
+      run = 0;
+      i += 31;
+      continue;
+    }
+    if(map[i/32] & (1 << (i%32))){
+      run = 0;
+      continue;
+    }
+    if(++run == n){
+      for(i = i - n + 1, run = 0; run < n; run++){
+        map[(i+run)/32] |= 1 << ((i+run)%32);
+        if(swapdev)
+          swap.ref[i+run] = 1;
+      }
+      if(swapdev)
+        release(&swap.lock);
+      return i;
+    }
+  }
+  if(swapdev)
+    release(&swap.lock);
+  return -1;
+}
+
+void
+swapfree(struct proc *p, int slot)
+{
+  uint *map;
+
+  if(slot == ZEROSLOT)
+    return;
+  if(slot >= ZRAMSLOT){
+    zramfree(slot - ZRAMSLOT);
+    return;
+  }
+  if(swapdev){
+    if(slot < 0 || slot >= swap.nslots)
+      panic("swapfree: bad slot");
+    map = swap.map;
+    acquire(&swap.lock);
+  } else {
+    if(slot < 0 || slot >= FILESLOTS)
+      panic("swapfree: bad slot");
+    map = p->swap_bitmap;
+  }
+  if((map[slot/32] & (1 << (slot%32))) == 0)
+    panic("swapfree: slot not in use");
+  if(swapdev && --swap.ref[slot] > 0){
+    release(&swap.lock);
+    return;                    // someone else still has the page there
+  }
+  map[slot/32] &= ~(1 << (slot%32));
+  if(swapdev)
+    release(&swap.lock);
+}
+
+// Add a reference to a slot that can be shared: one in the
+// compressed pool or on the raw area. Returns -1 for a swap
+// file slot, those belong to one process.
+static int
+swapshare(int slot)
+{
+  if(slot == ZEROSLOT)
+    return 0;
+  if(slot >= ZRAMSLOT)
+    return zramdup(slot - ZRAMSLOT);
+  if(!swapdev)
+    return -1;
+  acquire(&swap.lock);
+  if((swap.map[slot/32] & (1 << (slot%32))) == 0)
+    panic("swapshare: slot not in use");
+  if(swap.ref[slot] == 255)
+    panic("swapshare: too many references");
+  swap.ref[slot]++;
+  release(&swap.lock);
+  return 0;
+}
+
+static int
+zeropage(char *pg)
+{
+  uint *w;
+
+  for(w = (uint*)pg; w < (uint*)(pg + PGSIZE); w++)
+    if(*w)
+      return 0;
+  return 1;
+}
+
+// Try to keep the page at pg without writing it to swap space:
+// as ZEROSLOT if it is all zeros, else compressed in RAM.
+// Returns its slot, or -1 if it has to go to swap space.
+int
+swapstore(char *pg)
+{
+  if(zeropage(pg)){
+    acquire(&swap.lock);
+    zeroPageOuts++;
+    release(&swap.lock);
+    return ZEROSLOT;
+  }
+#if ZRAM == TRUE
+  int e;
+
+  if((e = zramstore(pg)) >= 0)
+    return ZRAMSLOT + e;
+#endif
+  return -1;
+}
+
+// Write the n pages pg[0..n-1] to slots slot..slot+n-1 with one
+// request, on the raw area without a copy. Returns 0 on success.
+int
+swapwrite(struct proc *p, char **pg, int slot, int n)
+{
+  if(swapdev)
+    return ideswaprw(pg, slot * SLOTSECTORS, n, 1);
+  return writePagesToSwapFile(p, pg, slot * PGSIZE, n);
+}
+
+// Read slots slot..slot+n-1 into the n pages pg[0..n-1].
+// Returns 0 on success.
+int
+swapread(struct proc *p, char **pg, int slot, int n)
+{
+  int i;
+
+  if(slot == ZEROSLOT){
+    for(i = 0; i < n; i++)
+      memset(pg[i], 0, PGSIZE);
+    return 0;
+  }
+  if(slot >= ZRAMSLOT){
+    for(i = 0; i < n; i++)
+      if(zramload(slot - ZRAMSLOT + i, pg[i]) < 0)
+        return -1;
+    return 0;
+  }
+  if(swapdev)
+    return ideswaprw(pg, slot * SLOTSECTORS, n, 0);
+  return readPagesFromSwapFile(p, pg, slot * PGSIZE, n);
+}
+
+// Give np every page p has in swap. cowuvm() leaves those PTEs
+// of np empty; fill them in here. Shared slots just gain a
+// reference, swap file slots are copied to np's swap file.
+int
+swapdup(struct proc *np, struct proc *p)
+{
+  char *buf;
+  pte_t *pte, *npte;
+  int slot;
+  uint a;
+
+  buf = 0;
+  for(a = 0; a < p->sz && np->swap_num_of_pages < p->swap_num_of_pages; a += PGSIZE){
+    if((pte = walkpgdir(p->pgdir, (char*)a, 0)) == 0 || !(*pte & PTE_PG))
+      continue;
+    if((npte = walkpgdir(np->pgdir, (char*)a, 1)) == 0)
+      break;
+    if(swapshare(PTE_SLOT(*pte)) == 0){
+      *npte = *pte;
+      np->swap_num_of_pages++;
+      continue;
+    }
+    if(buf == 0 && (buf = kalloc()) == 0)
+      break;
+    if(swapread(p, &buf, PTE_SLOT(*pte), 1) < 0)
+      break;
+    if((slot = swapstore(buf)) < 0){
+      if((slot = swapalloc(np, 1)) < 0)
+        break;
+      if(swapwrite(np, &buf, slot, 1) < 0){
+        swapfree(np, slot);
+        break;
+      }
+    }
+    *npte = SLOT2PTE(slot) | PTE_FLAGS(*pte);
+    np->swap_num_of_pages++;
+  }
+  if(buf)
+    kfree(buf);
+  return np->swap_num_of_pages == p->swap_num_of_pages ? 0 : -1;
+}
+
+uint getZeroPageOuts(){
+  return zeroPageOuts;
+}
@@ -0,0 +1,83 @@
+// Concurrent swap stress test: swaptest [nchild]
+// Forks nchild processes that each touch more pages than they may
+// keep in RAM, so they page out and fault back in at the same time
+// on all CPUs. Every word of every page holds its owner, page and
+// round; a child reports through a pipe whether all of it survived.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define PGSIZE   4096
+// A child may have MAX_PSYC_PAGES (16) pages in RAM plus what swap
+// takes for it: the raw area has room, a swap file only 17 pages
+// (MAXFILE blocks), and the program's own pages count too. So take
+// as many of NPAGES as sbrk() grants, but no fewer than MINPAGES, or
+// too little would be paged.
+#define NPAGES   36
+#define MINPAGES 20
+#define ROUNDS   8
+
+int
+check(char *mem, int npages, int id)
+{
+  uint *w;
+  int r, i, j, pg;
+
+  for(i = 0; i < npages; i++){
+    w = (uint*)(mem + i*PGSIZE);
+    for(j = 0; j < PGSIZE/4; j++)
+      w[j] = id << 24 | i << 16 | j;
+  }
+  for(r = 1; r <= ROUNDS; r++){
+    // walk up on odd rounds and down on even ones, so the pages
+    // just faulted in are not the next to be needed
+    for(i = 0; i < npages; i++){
+      pg = (r & 1) ? i : npages-1-i;
+      w = (uint*)(mem + pg*PGSIZE);
+      for(j = 0; j < PGSIZE/4; j++){
+        if(w[j] != (((id + r - 1) & 0xFF) << 24 | pg << 16 | j))
+          return -1;
+        w[j] += 1 << 24;
+      }
+    }
+  }
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fd[2], n, i, bad, np;
+  char *mem, c;
+
+  n = argc > 1 ? atoi(argv[1]) : 4;
+  if(pipe(fd) < 0){
+    printf(2, "swaptest: pipe failed\n");
+    exit();
+  }
+  for(i = 0; i < n; i++){
+    if(fork() == 0){
+      close(fd[0]);
+      c = 'n';
+      for(np = NPAGES; (mem = sbrk(np*PGSIZE)) == (char*)-1 && np > MINPAGES; np--)
+        ;
+      if(mem != (char*)-1 && check(mem, np, i) == 0)
+        c = 'y';
+      write(fd[1], &c, 1);
+      exit();
+    }
+  }
+  close(fd[1]);
+  bad = n;
+  while(read(fd[0], &c, 1) == 1)
+    if(c == 'y')
+      bad--;
+  for(i = 0; i < n; i++)
+    wait();
+  if(bad)
+    printf(1, "swaptest: %d of %d children FAILED\n", bad, n);
+  else
+    printf(1, "swaptest: %d children OK\n", n);
+  exit();
+}
@@ -103,6 +103,12 @@ extern int sys_unlink(void);
 extern int sys_wait(void);
 extern int sys_write(void);
 extern int sys_uptime(void);
+extern int sys_setpaging(void);
+extern int sys_setpff(void);
+extern int sys_setpolicy(void);
+extern int sys_tracectl(void);
+extern int sys_traceread(void);
+extern int sys_buddyinfo(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -126,6 +132,12 @@ static int (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_setpaging] sys_setpaging,
+[SYS_setpff] sys_setpff,
+[SYS_setpolicy] sys_setpolicy,
+[SYS_tracectl] sys_tracectl,
+[SYS_traceread] sys_traceread,
+[SYS_buddyinfo] sys_buddyinfo,
 };
 
 void
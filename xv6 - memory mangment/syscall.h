@@ -20,3 +20,9 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
+#define SYS_setpaging 22
+#define SYS_setpff 23
+#define SYS_setpolicy 24
+#define SYS_tracectl 25
+#define SYS_traceread 26
+#define SYS_buddyinfo 27
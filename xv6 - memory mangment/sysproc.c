@@ -6,6 +6,7 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
+#include "trace.h"
 
 int
 sys_fork(void)
@@ -89,3 +90,77 @@ sys_uptime(void)
   release(&tickslock);
   return xticks;
 }
+
+// Set the paging limits of the current process:
+// pages it may keep in RAM, pages it may have in all.
+int
+sys_setpaging(void)
+{
+  int resident, total;
+
+  if(argint(0, &resident) < 0 || argint(1, &total) < 0)
+    return -1;
+  return setpaging(resident, total);
+}
+
+// Set the page-fault frequency thresholds: faults per
+// window below which a resident limit shrinks, above which it grows.
+int
+sys_setpff(void)
+{
+  int low, high;
+
+  if(argint(0, &low) < 0 || argint(1, &high) < 0)
+    return -1;
+  return setpff(low, high);
+}
+
+// Set the page replacement policy of the current process,
+// or of all processes if the second argument is non-zero.
+int
+sys_setpolicy(void)
+{
+  int pol, all;
+
+  if(argint(0, &pol) < 0 || argint(1, &all) < 0)
+    return -1;
+  return setpolicy(pol, all);
+}
+
+// Turn page reference tracing on or off.
+int
+sys_tracectl(void)
+{
+  int on;
+
+  if(argint(0, &on) < 0)
+    return -1;
+  return tracectl(on);
+}
+
+// Drain up to n trace records into the buffer, n at most TRACESIZE
+// so the size check below cannot overflow.
+int
+sys_traceread(void)
+{
+  char *buf;
+  int n;
+
+  if(argint(1, &n) < 0 || n < 0 || n > TRACESIZE)
+    return -1;
+  if(argptr(0, &buf, n * sizeof(struct traceref)) < 0)
+    return -1;
+  return traceread((struct traceref*)buf, n);
+}
+
+// Free block counts of each order of the page allocator, into an
+// array of KMAXORDER+1. Returns the pages sitting in CPU caches.
+int
+sys_buddyinfo(void)
+{
+  char *buf;
+
+  if(argptr(0, &buf, (KMAXORDER+1) * sizeof(uint)) < 0)
+    return -1;
+  return buddyinfo((uint*)buf);
+}
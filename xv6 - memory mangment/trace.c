@@ -0,0 +1,96 @@
+// Page reference tracing, to replay what processes did against
+// other policies (pagesim.c). While tracectl(1) has it on, each
+// pageFault() and each look at a resident page that finds PTE_A set
+// (harvest() in policy.c) adds a record to a ring of TRACESIZE
+// records, which a user program drains with traceread(). A record
+// that finds the ring full is dropped and counted.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "trace.h"
+
+#define TRACECHUNK 32            // records traceread() copies per lock hold
+
+struct {
+  struct spinlock lock;
+  int on;
+  uint head;                     // next record to read
+  uint tail;                     // next record to write
+  uint dropped;
+  struct traceref ring[TRACESIZE];
+} trace;
+
+void
+traceinit(void)
+{
+  initlock(&trace.lock, "trace");
+}
+
+void
+traceref(struct proc *p, char *va, int kind)
+{
+  struct traceref *r;
+
+  if(!trace.on)
+    return;
+  acquire(&trace.lock);
+  if(trace.on){
+    if(trace.tail - trace.head == TRACESIZE)
+      trace.dropped++;
+    else {
+      r = &trace.ring[trace.tail++ % TRACESIZE];
+      r->va = (uint)va;
+      r->tick = ticks;
+      r->pid = p->pid;
+      r->kind = kind;
+    }
+  }
+  release(&trace.lock);
+}
+
+// Start tracing with an empty ring, or stop it.
+// Stopping returns the number of records dropped.
+int
+tracectl(int on)
+{
+  int dropped;
+
+  acquire(&trace.lock);
+  if(on){
+    trace.head = trace.tail = 0;
+    trace.dropped = 0;
+  }
+  trace.on = on;
+  dropped = trace.dropped;
+  release(&trace.lock);
+  return on ? 0 : dropped;
+}
+
+// Move up to n records to dst. Returns how many, or -1 once
+// tracing is off and the ring is empty.
+int
+traceread(struct traceref *dst, int n)
+{
+  struct traceref buf[TRACECHUNK];
+  int i, m, done;
+
+  for(done = 0; done < n; done += m){
+    acquire(&trace.lock);
+    if(trace.head == trace.tail && !trace.on && done == 0){
+      release(&trace.lock);
+      return -1;
+    }
+    for(m = 0; m < TRACECHUNK && done + m < n && trace.head != trace.tail; m++)
+      buf[m] = trace.ring[trace.head++ % TRACESIZE];
+    release(&trace.lock);
+    if(m == 0)
+      break;
+    for(i = 0; i < m; i++)       // dst is user memory, it may fault
+      dst[done + i] = buf[i];
+  }
+  return done;
+}
@@ -0,0 +1,10 @@
+// Page reference trace records, see trace.c and tracedump.c.
+#define TR_FAULT  1              // pageFault() at va
+#define TR_REF    2              // PTE_A found set on va, and cleared
+
+struct traceref {
+  uint va;                       // page address
+  uint tick;                     // ticks when it was recorded
+  ushort pid;
+  ushort kind;
+};
@@ -0,0 +1,54 @@
+// Record the page references of a command: tracedump file cmd [args]
+// turns on kernel tracing, runs cmd, and drains the trace ring
+// into file while it runs. pagesim -k file replays it.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "trace.h"
+
+#define NREC 128
+
+struct traceref buf[NREC];
+
+int
+main(int argc, char *argv[])
+{
+  int fd, n, pid, drainer;
+
+  if(argc < 3){
+    printf(2, "usage: tracedump file cmd [args]\n");
+    exit();
+  }
+  if((fd = open(argv[1], O_CREATE|O_RDWR)) < 0){
+    printf(2, "tracedump: cannot open %s\n", argv[1]);
+    exit();
+  }
+  tracectl(1);
+  if((drainer = fork()) == 0){
+    while((n = traceread(buf, NREC)) >= 0){
+      if(n == 0)
+        sleep(1);
+      else if(write(fd, buf, n * sizeof(buf[0])) != n * sizeof(buf[0])){
+        printf(2, "tracedump: write failed\n");
+        break;
+      }
+    }
+    exit();
+  }
+  if((pid = fork()) == 0){
+    close(fd);
+    exec(argv[2], argv + 2);
+    printf(2, "tracedump: exec %s failed\n", argv[2]);
+    exit();
+  }
+  while(wait() != pid)
+    ;
+  n = tracectl(0);                 // the drainer empties the ring and exits
+  wait();
+  close(fd);
+  if(n > 0)
+    printf(1, "tracedump: %d records dropped\n", n);
+  exit();
+}
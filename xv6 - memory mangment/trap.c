@@ -54,7 +54,9 @@ trap(struct trapframe *tf){
   switch(tf->trapno){
 
   case T_PGFLT:
+    myproc()->vmbusy++;          // kswapd keeps off while we page
     pageFault();
+    myproc()->vmbusy--;
   break;
   
   case T_IRQ0 + IRQ_TIMER:
@@ -63,6 +65,7 @@ trap(struct trapframe *tf){
       ticks++;
       wakeup(&ticks);
       release(&tickslock);
+      agetick();
     }
     lapiceoi();
     break;
@@ -113,8 +116,10 @@ trap(struct trapframe *tf){
   // Force process to give up CPU on clock tick.
   // If interrupts were on while locks held, would need to check nlock.
   if(myproc() && myproc()->state == RUNNING &&
-     tf->trapno == T_IRQ0+IRQ_TIMER)
+     tf->trapno == T_IRQ0+IRQ_TIMER){
+    myproc()->vtime++;                     // a tick of run time
     yield();
+  }
 
   // Check if the process has been killed since we yielded
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
@@ -23,6 +23,12 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+int setpaging(int, int);
+int setpff(int, int);
+int setpolicy(int, int);
+int tracectl(int);
+int traceread(void*, int);
+int buddyinfo(uint*);
 
 // ulib.c
 int stat(const char*, struct stat*);
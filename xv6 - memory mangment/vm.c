@@ -8,13 +8,8 @@
 #include "elf.h"
 #include "fs.h"
 #include "spinlock.h"
-
-#define NONE 0
-#define NFUA 1
-#define LAPA 2
-#define SCFIFO 3
-#define AQ 4
-#define FIFO 9
+#include "policy.h"
+#include "trace.h"
 
 
 
@@ -25,7 +20,8 @@ pde_t *kpgdir;  // for use in scheduler()
 struct spinlock lock;
 
 char pg_refcount[PHYSTOP >> PGSHIFT]; // array to store refcount, pgshift defined in memlayout.h
-static char buffer[PGSIZE];
+static uint raHits, raMisses;              // read-ahead pages used / dropped unused
+static uint swapWrites;                    // pages pageOut has written to swap
 
 // Set up CPU's kernel segment descriptors.
 // Run once on entry on each CPU.p = myproc();
@@ -233,170 +229,171 @@ loaduvm(pde_t *pgdir, char *addr, struct inode *ip, uint offset, uint sz)
   return 0;
 }
 
-char* SC_FIFO(struct proc* p){
-  cprintf("enter scfifo\n");
-  pte_t* pte;
-  int oldOut;
-  for(; p->out_index < MAX_PSYC_PAGES; p->out_index = (p->out_index + 1) % 16){
-    pte = walkpgdir(p->pgdir,p->ram_queue[p->out_index].va,0);
-      if(*pte & PTE_A){ 
-        *pte &= ~PTE_A;
-        continue;
-      }
-      else{
-          oldOut = p->out_index;
-          p->out_index = (p->out_index + 1) % 16;
-          return p->ram_queue[oldOut].va;
-      }
-  }
-  return 0; // we shouldnt get here
-}  
-
-char * fifo(struct proc * p){ //default is second chance fifo, for now we do fifo
-  cprintf("fifo\n");
-  int oldOut = p->out_index;
-  p->out_index = (p->out_index + 1) % 16;
-  return (char*)p->ram_queue[oldOut].va;
+// A read-ahead page counts as a hit once it is seen referenced,
+// and as a miss if it leaves RAM without having been used.
+void
+raAccount(pte_t *pte)
+{
+  if(!(*pte & PTE_RA))
+    return;
+  acquire(&lock);
+  if(*pte & PTE_A)
+    raHits++;
+  else
+    raMisses++;
+  release(&lock);
+  *pte &= ~PTE_RA;
 }
 
+uint getRaHits(){
+  return raHits;
+}
 
-char * nfua(struct proc * p){
-  cprintf("enter nfua\n");
-  uint max = p->ram_queue[0].nfua_counter;
-  for(int i = 1;i < MAX_PSYC_PAGES; i++){ // find max
-    if(max <= p->ram_queue[i].nfua_counter)
-      max = p->ram_queue[i].nfua_counter;
-  }
-  for(int i=0; i < MAX_PSYC_PAGES; i++){
-    if (max == p->ram_queue[i].nfua_counter)
-      return p->ram_queue[i].va;
-  }
-  panic("finding max makes no sense");
-  return 0;
+uint getRaMisses(){
+  return raMisses;
 }
 
-int find_numOnes(uint curr){
-  int count = 0;
-  for(int i = 0; i < 32; i++){
-    if(curr & 1){
-      count ++;
-    }
-    curr = curr >> 1;
-  }
-  return count;
+uint getSwapWrites(){
+  return swapWrites;
 }
 
-char* lapa(struct proc* p){
-  int count = 0;
-  int arr [16];
-  int value = 0xFFFFFFFF;
-  int max_num_of_one = find_numOnes(p->ram_queue[0].nfua_counter);
-  for(int i = 1;i < MAX_PSYC_PAGES; i++){ 
-    int curr = find_numOnes(p->ram_queue[i].nfua_counter);
-      if(max_num_of_one < curr)
-         max_num_of_one = curr;
-      else if( max_num_of_one == curr){
-        count ++;
-        arr[i] = 1;
-      }
-  }
-  if(count == 0){
-    for(int i=0; i < MAX_PSYC_PAGES; i++){
-      if (max_num_of_one == p->ram_queue[i].nfua_counter)
-        return p->ram_queue[i].va;
-      }
-  }
-  else{
-    for(int i=0; i < MAX_PSYC_PAGES; i++){
-      if(arr[i] == 1){
-          if(p->ram_queue[i].nfua_counter < value){
-            value = p->ram_queue[i].nfua_counter;
-          }
+// Evict up to n pages of p with a single swap write: pick the victims
+// with choosePage(), write them straight from their frames to a run
+// of consecutive slots and flush the TLB once. A clean page that still
+// has its copy in swap is not written at all. Returns the number of
+// pages evicted.
+int pageOutCluster(struct proc* p, int n){
+    char* pg[SWAPCLUSTER];
+    char* frame[SWAPCLUSTER];
+    pte_t* pte[SWAPCLUSTER];
+    int slot[SWAPCLUSTER], disk[SWAPCLUSTER];
+    uint pa;
+    int i, j, k, m, s, cached;
+    if(n > SWAPCLUSTER)
+      n = SWAPCLUSTER;
+    if(n > p->phy_index)
+      n = p->phy_index;
+    for(i = m = 0; i < n; i++){
+      pg[i] = choosePage(p);
+      if(pg[i] == 0)
+        panic("pg = 0"); 
+      k = findInRam(p, pg[i]);
+      cached = p->ram_queue[k].slot;
+      pte[i] = p->ram_queue[k].pte;            // the PTE of the chosen page
+      removePage(p, k);                        // so the next choice is a different page
+      raAccount(pte[i]);
+      if(cached >= 0){
+        if(!(*pte[i] & PTE_D)){
+          slot[i] = cached;                    // clean, swap already has it
+          continue;
         }
+        swapfree(p, cached);                   // stale copy
       }
-      //value is smallest
-      for(int i=0; i < MAX_PSYC_PAGES; i++){
-        if(arr[i] == 1){
-          if (value == p->ram_queue[i].nfua_counter)
-            return p->ram_queue[i].va;
-        }
-     }
-  }
-  return 0;
+      if((slot[i] = swapstore(P2V(PTE_ADDR(*pte[i])))) >= 0)
+        continue;                              // zero page, or kept compressed in RAM
+      disk[m] = i;
+      frame[m++] = P2V(PTE_ADDR(*pte[i]));     // through the kernel mapping, p may not be the current process
+    }
+    for(i = 0; i < m; i += k){                 // the rest go to disk, as few requests as the free runs allow
+      k = m - i;
+      while((s = swapalloc(p, k)) < 0 && k > 1)  // lowest free run of slots on the swap device or in the swap file
+        k /= 2;
+      if(s < 0){
+        swapdrop(p);                           // give up the copies of resident pages
+        s = swapalloc(p, k);
+      }
+      if(s < 0)
+        panic("pageOut: out of swap space");
+      if(swapwrite(p, frame + i, s, k) < 0)
+        panic("swapwrite failed\n");
+      for(j = 0; j < k; j++)
+        slot[disk[i+j]] = s + j;
+    }
+    acquire(&lock);
+    for(i = 0; i < n; i++){
+      pa = PTE_ADDR(*pte[i]);
+      if(pg_refcount[pa >> PGSHIFT] > 0)
+        pg_refcount[pa >> PGSHIFT] -= 1;       // refCount--
+      if(pg_refcount[pa >> PGSHIFT] == 0)
+        kfree(P2V(pa));                        // free the page if no one else maps it
+      *pte[i] = SLOT2PTE(slot[i]) | (PTE_FLAGS(*pte[i]) & ~PTE_P) | PTE_PG;   // the PTE remembers the slot
+    }
+    swapWrites += m;
+    release(&lock);
+    if(p == myproc())
+      lcr3(V2P(p->pgdir));                     // refresh the TLB (kswapd only takes pages of a process that is not running)
+    p->numOfPageOut += n;
+    p->numOfSwapWrites += m;
+    p->physical_num_of_pages -= n;
+    p->swap_num_of_pages += n;
+    return n;
 }
 
-char* aq(struct proc * p){
-
-  return p->ram_queue[15].va;
+void pageOut(struct proc* p){
+  pageOutCluster(p, 1);
 }
 
+// Evict the first page the global clock hand finds that was not
+// referenced since the hand last passed it, in whatever process
+// uses GLOBAL. Returns 0 if none has a page that can be taken now.
+static int
+globalPageOut(void)
+{
+  struct proc *self = myproc(), *p;
+  pte_t *pte;
+  int i;
 
-char * choosePage(struct proc * p){ //default is second chance fifo
-
- #if SELECTION == SCFIFO
-     return SC_FIFO(p);
-  #endif
-
- #if SELECTION == FIFO
-     return fifo(p);
-  #endif
-
- #if SELECTION == NFUA
-     return nfua(p);
-  #endif
-
- #if SELECTION == LAPA
-     return lapa(p);
-  #endif
-
-  #if SELECTION == AQ
-     return aq(p);
-  #endif
-  
-
+  for(i = 0; i <= NPROC; i++){            // the second visit of a process finds its bits clear
+    if((p = clockproc(self)) == 0)
+      return 0;
+    if(policyof(p) != GLOBAL){              // it just switched away
+      clockdone(p, 1);
+      continue;
+    }
+    for(; p->out_index < p->phy_index; p->out_index++){
+      pte = p->ram_queue[p->out_index].pte;
+      if(*pte & PTE_A){
+        harvest(p, p->out_index);
+        continue;
+      }
+      pageOutCluster(p, 1);
+      clockdone(p, 0);
+      return 1;
+    }
+    p->out_index = 0;
+    clockdone(p, 1);
+  }
   return 0;
 }
 
-void pageOut(struct proc* p){
-  cprintf("pageOut\n");
-    p->numOfPageOut ++;
-    char* pg = choosePage(p);
-    if(pg == 0)
-      panic("pg = 0"); 
-    pte_t* pte;
-    uint pa;
-    pte = walkpgdir(p->pgdir,pg,0);            // get the PTE of the chosen page
-    pa = PTE_ADDR(*pte);
-    memmove(buffer,pg,PGSIZE);                 // pg or v2p(pg)? the v2p caused a deadlock for some reason
-    if(writeToSwapFile(p, buffer, (p->swapMetaCounter * PGSIZE), PGSIZE) < 0)   // write the data of the chosen page to the swap file in the right loctaion
-      panic("writeToSwapFile failed\n");
-    // memmove(buffer,pg + PGSIZE/2,PGSIZE/2);      // pg or v2p(pg)? the v2p caused a deadlock for some reason
-    // if(writeToSwapFile(p, buffer, (p->swapMetaCounter * PGSIZE) + PGSIZE/2, PGSIZE/2) < 0)   // write the data of the chosen page to the swap file in the aviable loctaion
-    //   panic("writeToSwapFile failed\n");
-    p->meta[p->swapMetaCounter].va = pg;       // put the va in meta for task 1.2
-    pg_refcount[pa >> PGSHIFT] -= 1;           // refCount--
-    if(pg_refcount[pa >> PGSHIFT] == 1)
-      kfree(pg);                               // free the page
-    p->meta[p->swapMetaCounter].location = p->swapMetaCounter * PGSIZE;
-    p->swapMetaCounter++;
-    *pte &= ~PTE_P;   
-    *pte |= PTE_PG;                            // set\turn on the PTE_PG bit in page table
-    cprintf("fun with flags\n");
-    // *p->pgdir &= ~PTE_P;                    // clear\turn off the PTE_P bit in directory table(same as clear pte_u, line 341)
-    // *p->pgdir |= PTE_PG;                    // set\turn on the PTE_PG bit in directory table
-    lcr3(V2P(p->pgdir));                       // refresh the TLB
-    p->physical_num_of_pages --;
-    p->phy_index--;                          
+// Pages p can bring into RAM before something has to be paged out.
+static int
+room(struct proc *p)
+{
+  int n = (int)p->max_psyc_pages - (int)p->physical_num_of_pages;
+  int g;
+  if(policyof(p) == GLOBAL){
+    g = GLOBAL_PSYC_PAGES - residentpages();
+    if(g < n)
+      n = g;
+  }
+  return n;
 }
 
-
-void shiftPages(struct proc * p, char * mem){
-  for (int i = p->phy_index; i >= 1; i--){
-    p->ram_queue[i].va = p->ram_queue[i-1].va;
-    p->ram_queue[i].nfua_counter = p->ram_queue[i-1].nfua_counter;
-  }
-  p->ram_queue[0].va = mem;
+// Page out so that p can bring in one more page. A local policy
+// takes p's own pages, up to n at once; GLOBAL takes one wherever
+// the global clock finds it, or lets the pool run over if there is
+// no page it can take right now.
+static void
+makeRoom(struct proc *p, int n)
+{
+  int pol = policyof(p);
+  while(p->physical_num_of_pages >= p->max_psyc_pages)
+    pageOutCluster(p, n);
+  if(pol == GLOBAL && residentpages() >= GLOBAL_PSYC_PAGES)
+    globalPageOut();
 }
+
 /*
 int classic_allocuvm(pde_t *pgdir, uint oldsz, uint newsz){
   char *mem;
@@ -442,13 +439,16 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 
   a = PGROUNDUP(oldsz);
   struct proc * p = myproc();
-  if(p->current_num_of_pages < TOTAL_PSYC_PAGES){ //32
+  int own = p->pid > 2 && pgdir == p->pgdir;   // exec's new image is tracked once it is p's, see trackImage()
+  uint want = own ? p->current_num_of_pages + (PGROUNDUP(newsz) - a) / PGSIZE : PGROUNDUP(newsz) / PGSIZE;
+  uint limit = p->total_psyc_pages;
+  if(!own && limit > MAX_RAM_QUEUE)
+    limit = MAX_RAM_QUEUE;                     // all of exec's image is resident when trackImage() takes it
+  if(p->pid <= 2 || want <= limit){
   for(; a < newsz; a += PGSIZE){
     // check if we alloc more pages or swap pages
-    if (p->pid > 2){
-      if (p->physical_num_of_pages >= MAX_PSYC_PAGES){ //16
-          pageOut(p);
-      }
+    if (own){
+      makeRoom(p, PGROUNDUP(newsz - a) / PGSIZE);   // room for the rest of the growth at once
     } 
     mem = kalloc();
     if(mem == 0){
@@ -470,22 +470,8 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
     release(&lock);
     }
     
-    if(p->pid > 2){
-      p->ram_queue[p->phy_index].va = mem;  // virtual address the kernel gave to the page
-     
-      #if SELECTION == AQ
-        shiftPages(p,mem);
-      #endif
-     
-      #if SELECTION == LAPA
-        p->ram_queue[p->phy_index].nfua_counter = 0xFFFFFFFF;
-      #endif
-     
-      #if SELECTION == NFUA
-        p->ram_queue[p->phy_index].nfua_counter = 0;
-      #endif
-      
-      p->phy_index++;
+    if(own){
+      addPage(p, (char*)a, walkpgdir(pgdir, (char*)a, 0));   // user virtual address of the page
       p->physical_num_of_pages ++;           
       p->current_num_of_pages ++;
     }
@@ -496,6 +482,23 @@ cprintf("TOTAL_PSYC_PAGES\n");
 return 0;
 }
 
+// Put the resident pages of p's image in its ram_queue. exec calls
+// it once the new image is p's, so no PTE of an image that may
+// still be thrown away is ever cached there.
+void
+trackImage(struct proc *p)
+{
+  pte_t *pte;
+  uint a;
+
+  for(a = 0; a < p->sz; a += PGSIZE)
+    if((pte = walkpgdir(p->pgdir, (char*)a, 0)) != 0 && (*pte & PTE_P)){
+      addPage(p, (char*)a, pte);
+      p->physical_num_of_pages++;
+      p->current_num_of_pages++;
+    }
+}
+
 // Deallocate user pages to bring the process size from oldsz to
 // newsz.  oldsz and newsz need not be page-aligned, nor does newsz
 // need to be less than oldsz.  oldsz can be larger than the actual
@@ -504,6 +507,9 @@ int
 deallocuvm(pde_t *pgdir, uint oldsz, uint newsz){
   pte_t *pte;
   uint a, pa;
+  int i;
+  struct proc *p = myproc();
+  int own = p != 0 && p->pid > 2 && p->pgdir == pgdir;   // only the running image is in p's bookkeeping
 
   if(newsz >= oldsz)
     return oldsz;
@@ -518,23 +524,30 @@ deallocuvm(pde_t *pgdir, uint oldsz, uint newsz){
       if(pa == 0)
         panic("kfree from deallocuvm");
       char *v = P2V(pa);
+      raAccount(pte);
       *pte = 0;   // if refCount > 1 we dont want the pte but we dont do kfree
-      if(myproc()->pid > 2){   
-        acquire(&lock);
+      acquire(&lock);
+      if(pg_refcount[pa >> PGSHIFT] > 0)
         pg_refcount[pa >> PGSHIFT] -= 1;
-        if(pg_refcount[pa >> PGSHIFT] == 0){          // if no other page table is pointing to this page remove it 
-          kfree(v);
-        }
-        release(&lock);
-        if(myproc()->physical_num_of_pages > 0 && myproc()->current_num_of_pages >0){
-        myproc()->physical_num_of_pages --;
-        myproc()->current_num_of_pages --;
-        myproc()->phy_index --;   // next time we put a different page instead of the page that is there now
-        }
-      }
-      else{
+      if(pg_refcount[pa >> PGSHIFT] == 0){          // if no other page table is pointing to this page remove it 
         kfree(v);
       }
+      release(&lock);
+      if(own && (i = findInRam(p, (char*)a)) >= 0){
+        if(p->ram_queue[i].slot >= 0)
+          swapfree(p, p->ram_queue[i].slot);
+        removePage(p, i);
+        p->physical_num_of_pages --;
+        p->current_num_of_pages --;
+      }
+    }
+    else if((*pte & PTE_PG) != 0){                  // paged out, give its slot back
+      swapfree(p, PTE_SLOT(*pte));
+      *pte = 0;
+      if(own){
+        p->swap_num_of_pages --;
+        p->current_num_of_pages --;
+      }
     }
   }
     return newsz;
@@ -617,6 +630,8 @@ cowuvm(pde_t *pgdir, uint sz){
   for(i = 0; i < sz; i += PGSIZE){
     if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
       panic("cowuvm: pte should exist");
+    if(*pte & PTE_PG)         // paged out, swapdup() gives the child its own copy
+      continue;
     if(!(*pte & PTE_P))
       panic("cowuvm: page not present");
     if(*pte & PTE_W){         // check the page is writable
@@ -629,6 +644,8 @@ cowuvm(pde_t *pgdir, uint sz){
       goto bad;
     }
     acquire(&lock);
+    if(pg_refcount[pa >> PGSHIFT] == 0)   // not counted yet (copyuvm, inituvm), it had one owner
+      pg_refcount[pa >> PGSHIFT] = 1;
     pg_refcount[pa >> PGSHIFT] = pg_refcount[pa >> PGSHIFT] + 1;
     release(&lock);   
   }
@@ -690,48 +707,90 @@ copyout(pde_t *pgdir, uint va, void *p, uint len)
 //PAGEBREAK!
 // Blank page.
 
+// Swap slot of the paged out page at user address va, -1 if it is not in swap.
 int findInSwapFile(struct proc* p, char* va){
-  for(int i = 0; i < MAX_PSYC_PAGES ; i++){
-    if(p->meta[i].va == va){
-      return i;
-    }
-  }
-  return -1;
+  pte_t *pte = walkpgdir(p->pgdir, va, 0);
+  if(pte == 0 || !(*pte & PTE_PG))
+    return -1;
+  return PTE_SLOT(*pte);
 }
 
 
+// Bring the page at a back from swap, and with it up to SWAPRA-1
+// swapped pages that follow it in p's address space, as long as p
+// has resident slots and the system has frames to spare. Each run
+// of consecutive slots is read with one request.
+static void
+swapIn(struct proc *p, char *a)
+{
+  char *mem[SWAPRA], *va[SWAPRA];
+  pte_t *pte[SWAPRA];
+  int slot[SWAPRA];
+  int i, j, k, n, max;
+
+  max = room(p);
+  if(max < 1)
+    max = 1;                                   // over the limit after exec, bring in just the one
+  if(max > SWAPRA)
+    max = SWAPRA;
+  if(getCurrentNumOfFreePages() < KSWAPD_LOW)
+    max = 1;                                   // memory is tight, no read-ahead
+  for(n = 0; n < max && (uint)a < p->sz; n++, a += PGSIZE){
+    if((pte[n] = walkpgdir(p->pgdir, a, 0)) == 0 || !(*pte[n] & PTE_PG))
+      break;
+    if((mem[n] = kalloc()) == 0)
+      break;
+    va[n] = a;
+    slot[n] = findInSwapFile(p, a);            // the PTE knows the slot
+  }
+  if(n == 0)
+    panic("swapIn: out of memory");
+  for(i = 0; i < n; i = j){
+    for(j = i + 1; j < n && slot[i] != ZEROSLOT && slot[j] == slot[j-1] + 1; j++)
+      ;
+    if(swapread(p, mem + i, slot[i], j - i) < 0)   // straight into the frames
+      panic("swapread failed\n");
+  }
+  for(i = 0; i < n; i++)
+    if(slot[i] >= ZEROSLOT)
+      swapfree(p, slot[i]);                    // a disk slot stays, while the page is clean
+  acquire(&lock);
+  for(i = 0; i < n; i++)
+    pg_refcount[V2P(mem[i]) >> PGSHIFT] = 1;
+  release(&lock);
+  for(i = 0; i < n; i++){
+    *pte[i] = V2P(mem[i]) | (PTE_FLAGS(*pte[i]) & ~(PTE_PG|PTE_A|PTE_D)) | PTE_P;
+    if(i > 0)
+      *pte[i] |= PTE_RA;                       // raAccount() tells if it gets used
+    k = addPage(p, va[i], pte[i]);
+    if(slot[i] < ZEROSLOT)
+      p->ram_queue[k].slot = slot[i];
+    if(i == 0 && p->policy == CLOCKPRO && ghostHit(p, va[i]))
+      p->ram_queue[k].hot = 1;                 // back soon after it left, it is reused
+  }
+  p->physical_num_of_pages += n;
+  p->swap_num_of_pages -= n;
+}
+
 void pageFault(){
   char* a;
   char* v;
   char * mem;
   uint pa;
-  char * new_pg ;
   pte_t * pte;
   struct proc * p;
-  int index;
   p = myproc();
   p->numOfPageFaults++;
   if (p->pid > 2){
     uint va = rcr2();                                     // catch virtual address of fault
     a = (char*)PGROUNDDOWN(va);                           // va of the page
+    traceref(p, a, TR_FAULT);
     pte = walkpgdir(p->pgdir,a,0);
-    pa = PTE_ADDR(*pte);
+    if(pte == 0)
+      return;
     if(*pte & PTE_PG){                                    // check if the page we want is in swapFile
-      // if(pg_refcount[pa >> PGSHIFT] == 0) 
-      if(p->physical_num_of_pages == MAX_PSYC_PAGES)
-        pageOut(p);                                       // send a page to the swap file
-      new_pg = kalloc(); 
-      index = findInSwapFile(p,a);                        // find the va in meta  
-      if(readFromSwapFile(p,buffer, p->meta[index].location,PGSIZE) < 0)   // need to be changed in task 3
-        cprintf("unable to read from swapfile1\n");
-      p->swapMetaCounter--;                               // get out the page
-      memmove(new_pg,buffer,PGSIZE);                      // put the va that kalloc returned to the page(virtual addr) that we want to replace
-      pg_refcount[pa >> PGSHIFT]++;                       
-      *pte &= ~PTE_PG;
-      *pte |= (uint)V2P(new_pg);                          //enter new pa to the pte that caused page fault
-      *pte |= PTE_P;
-      // mappages(p->pgdir,new_pg,PGSIZE,(uint)V2P(new_pg),PTE_FLAGS(*pte));
-
+      makeRoom(p, 1);                                     // send a page to the swap file
+      swapIn(p, a);                                       // and the swapped pages after it
       return;
     }
 
@@ -0,0 +1,301 @@
+// Compressed swap in RAM, tried by pageOut() before the disk.
+//
+// A page is compressed with a small LZ77 coder (the LZ4 block
+// format: a token byte with literal and match lengths, the literals,
+// then a 2-byte match offset) and stored in a pool of kalloc()ed
+// frames. Each pool frame is cut into ZCHUNK byte chunks and a
+// compressed page takes a run of chunks inside one frame. A frame
+// goes back to kalloc() once it holds no page. The pool only grows
+// while the system has frames to spare; after that it is full and
+// pages spill to the disk.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "spinlock.h"
+
+#define ZCHUNK     128                    // allocation unit in a pool frame
+#define ZCHUNKS    (PGSIZE/ZCHUNK)        // chunks per frame, one bit each
+#define ZMAXLEN    (PGSIZE*3/4)           // keep worse compressed pages on disk
+#define NZENTRY    (ZRAMPAGES*ZCHUNKS)    // most pages the pool can hold
+
+#define MINMATCH   4
+#define HASHBITS   10
+
+struct zentry {
+  char *pg;                    // pool frame, 0 if the entry is free
+  ushort off;                  // offset in the frame
+  ushort len;                  // compressed length
+  ushort ref;                  // page tables that point at the entry
+};
+
+struct {
+  struct spinlock lock;
+  char *frame[ZRAMPAGES];      // pool frames
+  uint map[ZRAMPAGES];         // bit set if chunk is in use
+  int nframes;
+  int npages;
+  int hint;                    // where to look for a free entry
+  struct zentry ent[NZENTRY];
+  ushort htab[1 << HASHBITS];  // compressor match finder
+  uchar tmp[PGSIZE];           // compressor output
+} zram;
+
+void
+zraminit(void)
+{
+  initlock(&zram.lock, "zram");
+}
+
+static uint
+hash4(uchar *p)
+{
+  uint v = p[0] | p[1] << 8 | p[2] << 16 | p[3] << 24;
+  return (v * 2654435761U) >> (32 - HASHBITS);
+}
+
+// Write one sequence: nlit literals, then a match of mlen bytes at
+// distance off (mlen == 0 for the last sequence). Returns the new
+// output position or 0 if it would pass oend.
+static uchar*
+lzemit(uchar *op, uchar *oend, uchar *lit, int nlit, int off, int mlen)
+{
+  uchar *tok;
+  int n;
+
+  if(op + 1 + nlit/255 + 1 + nlit + 2 + mlen/255 + 1 > oend)
+    return 0;
+  tok = op++;
+  *tok = (nlit < 15 ? nlit : 15) << 4;
+  if(nlit >= 15){
+    for(n = nlit - 15; n >= 255; n -= 255)
+      *op++ = 255;
+    *op++ = n;
+  }
+  memmove(op, lit, nlit);
+  op += nlit;
+  if(mlen == 0)
+    return op;
+  *op++ = off;
+  *op++ = off >> 8;
+  mlen -= MINMATCH;
+  *tok |= mlen < 15 ? mlen : 15;
+  if(mlen >= 15){
+    for(n = mlen - 15; n >= 255; n -= 255)
+      *op++ = 255;
+    *op++ = n;
+  }
+  return op;
+}
+
+// Compress the page at src into dst. Returns the compressed length,
+// or -1 if it does not fit in max bytes.
+static int
+lzcompress(uchar *src, uchar *dst, int max)
+{
+  uchar *ip, *anchor, *ref, *end, *op;
+  uint h;
+  int len;
+
+  memset(zram.htab, 0, sizeof(zram.htab));
+  end = src + PGSIZE;
+  op = dst;
+  for(ip = anchor = src; ip + MINMATCH <= end; ){
+    h = hash4(ip);
+    ref = src + zram.htab[h];
+    zram.htab[h] = ip - src;
+    if(ref >= ip || ref[0] != ip[0] || ref[1] != ip[1] || ref[2] != ip[2] || ref[3] != ip[3]){
+      ip++;
+      continue;
+    }
+    for(len = MINMATCH; ip + len < end && ref[len] == ip[len]; len++)
+      ;
+    if((op = lzemit(op, dst + max, anchor, ip - anchor, ip - ref, len)) == 0)
+      return -1;
+    ip += len;
+    anchor = ip;
+  }
+  if((op = lzemit(op, dst + max, anchor, end - anchor, 0, 0)) == 0)
+    return -1;
+  return op - dst;
+}
+
+// Decompress len bytes at src into the page at dst.
+// Returns 0 if they make up exactly one page.
+static int
+lzdecompress(uchar *src, int len, uchar *dst)
+{
+  uchar *ip, *iend, *op, *oend, *ref;
+  int tok, n, off;
+
+  ip = src;
+  iend = src + len;
+  op = dst;
+  oend = dst + PGSIZE;
+  while(ip < iend){
+    tok = *ip++;
+    n = tok >> 4;
+    if(n == 15){
+      do {
+        if(ip >= iend)
+          return -1;
+        n += *ip;
+      } while(*ip++ == 255);
+    }
+    if(ip + n > iend || op + n > oend)
+      return -1;
+    memmove(op, ip, n);
+    ip += n;
+    op += n;
+    if(ip == iend)
+      break;
+    if(ip + 2 > iend)
+      return -1;
+    off = ip[0] | ip[1] << 8;
+    ip += 2;
+    n = tok & 15;
+    if(n == 15){
+      do {
+        if(ip >= iend)
+          return -1;
+        n += *ip;
+      } while(*ip++ == 255);
+    }
+    n += MINMATCH;
+    ref = op - off;
+    if(off == 0 || ref < dst || op + n > oend)
+      return -1;
+    while(n-- > 0)            // may overlap, copy forward
+      *op++ = *ref++;
+  }
+  return op == oend ? 0 : -1;
+}
+
+// Find a run of n free chunks in frame f. Returns its first chunk.
+static int
+chunkalloc(int f, int n)
+{
+  uint m;
+  int i;
+
+  m = (n == 32) ? 0xFFFFFFFF : (1U << n) - 1;
+  for(i = 0; i + n <= ZCHUNKS; i++)
+    if((zram.map[f] & (m << i)) == 0){
+      zram.map[f] |= m << i;
+      return i;
+    }
+  return -1;
+}
+
+// Keep a compressed copy of the page at pg.
+// Returns its entry, or -1 if the pool is full or pg does not
+// compress well enough.
+int
+zramstore(char *pg)
+{
+  int len, n, f, c, e;
+
+  acquire(&zram.lock);
+  if((len = lzcompress((uchar*)pg, zram.tmp, ZMAXLEN)) < 0)
+    goto bad;
+  n = (len + ZCHUNK - 1) / ZCHUNK;
+  c = -1;
+  for(f = 0; f < ZRAMPAGES; f++)
+    if(zram.frame[f] && (c = chunkalloc(f, n)) >= 0)
+      break;
+  if(c < 0){
+    if(getCurrentNumOfFreePages() < KSWAPD_LOW)
+      goto bad;                 // frames are scarce, the pool is full
+    for(f = 0; f < ZRAMPAGES && zram.frame[f]; f++)
+      ;
+    if(f == ZRAMPAGES || (zram.frame[f] = kalloc()) == 0)
+      goto bad;
+    zram.nframes++;
+    c = chunkalloc(f, n);
+  }
+  for(e = zram.hint; zram.ent[e].pg; e = (e + 1) % NZENTRY)
+    ;
+  zram.hint = (e + 1) % NZENTRY;
+  zram.ent[e].pg = zram.frame[f];
+  zram.ent[e].off = c * ZCHUNK;
+  zram.ent[e].len = len;
+  zram.ent[e].ref = 1;
+  memmove(zram.frame[f] + c*ZCHUNK, zram.tmp, len);
+  zram.npages++;
+  release(&zram.lock);
+  return e;
+
+bad:
+  release(&zram.lock);
+  return -1;
+}
+
+// Decompress entry e into the page at pg. Returns 0 on success.
+int
+zramload(int e, char *pg)
+{
+  int r;
+
+  if(e < 0 || e >= NZENTRY)
+    panic("zramload: bad entry");
+  acquire(&zram.lock);
+  if(zram.ent[e].pg == 0)
+    panic("zramload: entry not in use");
+  r = lzdecompress((uchar*)zram.ent[e].pg + zram.ent[e].off, zram.ent[e].len, (uchar*)pg);
+  release(&zram.lock);
+  return r;
+}
+
+// Another page table points at entry e. Returns 0.
+int
+zramdup(int e)
+{
+  if(e < 0 || e >= NZENTRY)
+    panic("zramdup: bad entry");
+  acquire(&zram.lock);
+  if(zram.ent[e].pg == 0)
+    panic("zramdup: entry not in use");
+  zram.ent[e].ref++;
+  release(&zram.lock);
+  return 0;
+}
+
+void
+zramfree(int e)
+{
+  struct zentry *z;
+  int f, n;
+
+  if(e < 0 || e >= NZENTRY)
+    panic("zramfree: bad entry");
+  acquire(&zram.lock);
+  z = &zram.ent[e];
+  if(z->pg == 0)
+    panic("zramfree: entry not in use");
+  if(--z->ref > 0){
+    release(&zram.lock);
+    return;
+  }
+  for(f = 0; zram.frame[f] != z->pg; f++)
+    ;
+  n = (z->len + ZCHUNK - 1) / ZCHUNK;
+  zram.map[f] &= ~(((n == 32) ? 0xFFFFFFFF : (1U << n) - 1) << (z->off / ZCHUNK));
+  if(zram.map[f] == 0){           // last page in the frame
+    kfree(zram.frame[f]);
+    zram.frame[f] = 0;
+    zram.nframes--;
+  }
+  z->pg = 0;
+  zram.npages--;
+  release(&zram.lock);
+}
+
+uint getZramPages(){
+  return zram.npages;
+}
+
+uint getZramFrames(){
+  return zram.nframes;
+}